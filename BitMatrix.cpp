@@ -0,0 +1,94 @@
+//
+// Created on 17/10/26.
+//
+
+#include "BitMatrix.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define QB_HAVE_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
+
+/** Portable implementations
+ *
+ */
+
+static size_t intersection_count_scalar(const BITWORD* a, const BITWORD* b, int words) {
+    size_t res = 0;
+    for(int w = 0; w < words; w++)
+        res += __builtin_popcountll(a[w] & b[w]);
+    return res;
+}
+
+static bool intersect_scalar(const BITWORD* a, const BITWORD* b, int words) {
+    for(int w = 0; w < words; w++)
+        if(a[w] & b[w])
+            return true;
+    return false;
+}
+
+#ifdef QB_HAVE_AVX2_DISPATCH
+
+/** AVX2 implementations, a row is processed by blocks of 256 bits
+ *
+ * AVX2 has no popcount instruction, the bits are counted with a nibble lookup table (W. Mula's method)
+ */
+
+__attribute__((target("avx2"))) static inline __m256i popcount_256(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_and_si256(v, low_mask);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+    //Sum the bytes by groups of 8 into four 64-bit counters
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) static inline size_t horizontal_sum(__m256i v) {
+    return _mm256_extract_epi64(v, 0) + _mm256_extract_epi64(v, 1) + _mm256_extract_epi64(v, 2) + _mm256_extract_epi64(v, 3);
+}
+
+__attribute__((target("avx2"))) static size_t intersection_count_avx2(const BITWORD* a, const BITWORD* b, int words) {
+    __m256i acc = _mm256_setzero_si256();
+    for(int w = 0; w < words; w += 4) {
+        __m256i va = _mm256_loadu_si256((const __m256i*) (a + w));
+        __m256i vb = _mm256_loadu_si256((const __m256i*) (b + w));
+        acc = _mm256_add_epi64(acc, popcount_256(_mm256_and_si256(va, vb)));
+    }
+    return horizontal_sum(acc);
+}
+
+__attribute__((target("avx2"))) static bool intersect_avx2(const BITWORD* a, const BITWORD* b, int words) {
+    for(int w = 0; w < words; w += 4) {
+        __m256i va = _mm256_loadu_si256((const __m256i*) (a + w));
+        __m256i vb = _mm256_loadu_si256((const __m256i*) (b + w));
+        if(!_mm256_testz_si256(va, vb))
+            return true;
+    }
+    return false;
+}
+#endif
+
+/** Implementations used on the current processor, selected once at the first call
+ *
+ */
+struct BitKernels {
+    size_t (*intersection_count)(const BITWORD*, const BITWORD*, int);
+    bool (*intersect)(const BITWORD*, const BITWORD*, int);
+};
+
+static const BitKernels& kernels() {
+    static const BitKernels selected = [](){
+#ifdef QB_HAVE_AVX2_DISPATCH
+        if(__builtin_cpu_supports("avx2"))
+            return BitKernels{intersection_count_avx2, intersect_avx2};
+#endif
+        return BitKernels{intersection_count_scalar, intersect_scalar};
+    }();
+    return selected;
+}
+
+size_t bits_intersection_count(const BITWORD* a, const BITWORD* b, int words) { return kernels().intersection_count(a, b, words); }
+
+bool bits_intersect(const BITWORD* a, const BITWORD* b, int words) { return kernels().intersect(a, b, words); }
@@ -0,0 +1,82 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_BITMATRIX_H
+#define QUANTUM_BNP_BITMATRIX_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+//Type of a word in bit rows
+using BITWORD = uint64_t;
+
+//Number of bits in a word
+#define WORD_BITS 64
+
+/** Square matrix of bits stored row by row, each row is padded to a multiple of 4 words (256 bits)
+ *
+ * Is used as an adjacency matrix of dense graphs: edge tests are O(1), operations on neighborhoods are word-parallel.
+ */
+class BitMatrix {
+    int size;
+    int row_words;
+    vector<BITWORD> bits;
+
+public:
+    BitMatrix() : size(0), row_words(0) {};
+
+    /** Create a matrix of zeros
+     *
+     * @param n number of rows and columns
+     */
+    explicit BitMatrix(int n) : size(n), row_words((n + 4*WORD_BITS - 1) / (4*WORD_BITS) * 4), bits((size_t) n * row_words, 0) {};
+
+    /** Memory taken by the bits of a matrix with n rows
+     *
+     */
+    static size_t bytes(int n) { return (size_t) n * ((n + 4*WORD_BITS - 1) / (4*WORD_BITS) * 4) * sizeof(BITWORD); };
+
+    int get_size() const { return size; };
+    int get_row_words() const { return row_words; };
+    bool empty() const { return size == 0; };
+
+    void set(int u, int v) { bits[(size_t) u * row_words + v / WORD_BITS] |= BITWORD(1) << (v % WORD_BITS); };
+    bool test(int u, int v) const { return (bits[(size_t) u * row_words + v / WORD_BITS] >> (v % WORD_BITS)) & 1; };
+
+    const BITWORD* row(int u) const { return bits.data() + (size_t) u * row_words; };
+    BITWORD* row(int u) { return bits.data() + (size_t) u * row_words; };
+};
+
+/** Word-parallel operations on bit rows of the same length
+ *
+ * The length must be a multiple of 4 words. AVX2 versions are selected at runtime if the processor supports them.
+ */
+
+//Number of set bits in a & b
+size_t bits_intersection_count(const BITWORD* a, const BITWORD* b, int words);
+
+//True if a & b is not empty
+bool bits_intersect(const BITWORD* a, const BITWORD* b, int words);
+
+/** Call f(i) for every set bit i of the row in increasing order
+ *
+ * @param a
+ * @param words
+ * @param f
+ */
+template<class F>
+void for_each_bit(const BITWORD* a, int words, F f) {
+    for(int w = 0; w < words; w++) {
+        BITWORD word = a[w];
+        while(word) {
+            f(w * WORD_BITS + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+}
+
+#endif //QUANTUM_BNP_BITMATRIX_H
@@ -0,0 +1,142 @@
+//
+// Created on 17/10/26.
+//
+
+#include "CSRGraph.h"
+#include <algorithm>
+
+namespace {
+/** Arrays owned by a snapshot
+ *
+ */
+struct CSRArrays {
+    vector<int> offsets;
+    vector<N_ID> adjacency;
+    vector<WTYPE> weights;
+};
+}
+
+CSRGraph::CSRGraph(const Graph& graph):
+        weighted(graph.is_weighted()), node_number(graph.get_node_number()), edge_number(0), is_active(graph.get_node_number(), 0) {
+    auto arrays = make_shared<CSRArrays>();
+    arrays->offsets.assign(node_number + 1, 0);
+    arrays->weights.assign(node_number, 0);
+
+    const auto& graph_active = graph.get_active_nodes();
+    active_nodes.assign(graph_active.begin(), graph_active.end());
+
+    for(const auto& u: active_nodes) {
+        is_active[u] = 1;
+        arrays->weights[u] = graph.get_node_weight(u);
+        arrays->offsets[u+1] = graph.get_neighbors(u).size();
+    }
+    for(int u = 0; u < node_number; u++)
+        arrays->offsets[u+1] += arrays->offsets[u];
+
+    //Neighbor sets are ordered, so the rows are sorted without extra work
+    arrays->adjacency.resize(arrays->offsets[node_number]);
+    for(const auto& u: active_nodes) {
+        const auto& neighbors = graph.get_neighbors(u);
+        copy(neighbors.begin(), neighbors.end(), arrays->adjacency.begin() + arrays->offsets[u]);
+    }
+
+    offsets = arrays->offsets;
+    adjacency = arrays->adjacency;
+    weights = arrays->weights;
+    storage = std::move(arrays);
+    init_structure();
+}
+
+CSRGraph::CSRGraph(int size, vector<int> offsets, vector<N_ID> adjacency, vector<WTYPE> node_weights, bool is_weighted):
+        CSRGraph(size, {}, {}, {}, is_weighted, nullptr) {
+    auto arrays = make_shared<CSRArrays>(CSRArrays{std::move(offsets), std::move(adjacency), std::move(node_weights)});
+    if(arrays->offsets.empty())
+        arrays->offsets.assign(1, 0);
+    this->offsets = arrays->offsets;
+    this->adjacency = arrays->adjacency;
+    this->weights = arrays->weights;
+    storage = std::move(arrays);
+    init_structure();
+}
+
+CSRGraph::CSRGraph(int size, span<const int> offsets, span<const N_ID> adjacency, span<const WTYPE> node_weights, bool is_weighted, shared_ptr<const void> owner):
+        weighted(is_weighted), node_number(size), edge_number(0), storage(std::move(owner)),
+        offsets(offsets), adjacency(adjacency), weights(node_weights), is_active(size, 1), active_nodes(size) {
+    for(int u = 0; u < size; u++)
+        active_nodes[u] = u;
+    if(storage)
+        init_structure();
+}
+
+void CSRGraph::init_structure() {
+    edge_number = adjacency.size() / 2;
+
+    double n_active = active_nodes.size();
+    if(n_active > 1 && BitMatrix::bytes(node_number) <= DENSE_MAX_BYTES && 2 * edge_number >= DENSE_THRESHOLD * n_active * (n_active - 1))
+        dense_adjacency = make_shared<DenseAdjacency>();
+}
+
+const BitMatrix& CSRGraph::adjacency_matrix() const {
+    call_once(dense_adjacency->built, [this]() {
+        BitMatrix matrix(node_number);
+        for(const auto& u: active_nodes)
+            for(const auto& v: get_neighbors(u))
+                matrix.set(u, v);
+        dense_adjacency->matrix = std::move(matrix);
+    });
+    return dense_adjacency->matrix;
+}
+
+WTYPE CSRGraph::get_max_weight() const {
+    if(!weighted)
+        return 1;
+
+    WTYPE max_weight = 0;
+    for(const auto& u: active_nodes)
+        max_weight = max(max_weight, abs(weights[u]));
+    return max_weight;
+}
+
+bool CSRGraph::has_edge(const N_ID& u, const N_ID& v) const {
+    if(is_dense())
+        return adjacency_matrix().test(u, v);
+    if(get_degree(u) > get_degree(v))
+        return has_edge(v, u);
+    auto neighbors = get_neighbors(u);
+    return binary_search(neighbors.begin(), neighbors.end(), v);
+}
+
+bool is_independent_set(const CSRGraph& G, const N_CONTAINER& IS){
+    for(const auto & u: IS)
+        if(u < 0 || u >= G.get_node_number() || !G.is_active_node(u))
+            throw invalid_argument("The node " + to_string(u) + " isn't active");
+
+    if(G.is_dense()) {
+        //Compare the adjacency rows with the characteristic vector of the set
+        thread_local vector<BITWORD> in_set;
+        in_set.assign(G.get_row_words(), 0);
+        for(const auto & u: IS)
+            in_set[u / WORD_BITS] |= BITWORD(1) << (u % WORD_BITS);
+        for(const auto & u: IS)
+            if(bits_intersect(G.get_adjacency_row(u), in_set.data(), G.get_row_words()))
+                return false;
+        return true;
+    }
+
+    //Scratch marks of the set, all zero between calls, reused by later calls of the same thread
+    thread_local vector<char> in_set;
+    if((int) in_set.size() < G.get_node_number())
+        in_set.resize(G.get_node_number(), 0);
+    for(const auto & u: IS)
+        in_set[u] = 1;
+    bool independent = true;
+    for(auto it = IS.begin(); independent && it != IS.end(); it++)
+        for(const auto & v: G.get_neighbors(*it))
+            if(in_set[v]) {
+                independent = false;
+                break;
+            }
+    for(const auto & u: IS)
+        in_set[u] = 0;
+    return independent;
+}
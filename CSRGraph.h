@@ -0,0 +1,158 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_CSRGRAPH_H
+#define QUANTUM_BNP_CSRGRAPH_H
+
+#include <span>
+#include <memory>
+#include <mutex>
+#include "Graph.h"
+#include "BitMatrix.h"
+
+//Graphs whose density among active nodes is at least DENSE_THRESHOLD also store a bit adjacency matrix
+#define DENSE_THRESHOLD 0.25
+
+//The bit matrix takes about n^2/8 bytes and is built at its first use, it is never built if it takes more than DENSE_MAX_BYTES
+#define DENSE_MAX_BYTES (4 << 20)
+
+//Read-only view on the sorted neighbors of a node, doesn't allocate
+using NeighborView = span<const N_ID>;
+
+/** Frozen snapshot of a Graph in the compressed sparse row format
+ *
+ * Node identifiers are the same as in the source graph. The neighbors of every active node are stored contiguously and sorted,
+ * inactive (merged) nodes have no neighbors. The snapshot is not modified by later changes of the source graph.
+ * Heuristics that only read the graph should run on the snapshot instead of the Graph itself.
+ * The arrays are immutable and shared between copies, they may be owned by the snapshot or mapped from a binary file.
+ */
+class CSRGraph {
+    bool weighted;
+    int node_number;
+    int edge_number;
+
+    // Keeps alive the memory referenced by offsets, adjacency and weights
+    shared_ptr<const void> storage;
+
+    // The neighbors of u are stored in adjacency[offsets[u]] ... adjacency[offsets[u+1] - 1]
+    span<const int> offsets;
+    span<const N_ID> adjacency;
+
+    span<const WTYPE> weights;
+
+    // is_active[u] != 0 if the node u is active in the source graph
+    vector<char> is_active;
+
+    // Sorted list of active nodes
+    vector<N_ID> active_nodes;
+
+    /** Adjacency matrix of a dense graph, built by the first thread that uses it
+     *
+     */
+    struct DenseAdjacency {
+        once_flag built;
+        BitMatrix matrix;
+    };
+
+    // Null if the graph is sparse, shared between copies so that the matrix is built at most once
+    shared_ptr<DenseAdjacency> dense_adjacency;
+
+    /** Compute the number of edges and decide if the graph is dense
+     *
+     */
+    void init_structure();
+
+    /** The adjacency matrix of a dense graph, built at the first call
+     *
+     */
+    const BitMatrix& adjacency_matrix() const;
+
+public:
+    CSRGraph() : CSRGraph(0, {}, {}, {}, false) {};
+
+    /** Take a snapshot of the active part of the graph
+     *
+     * @param graph
+     */
+    explicit CSRGraph(const Graph& graph);
+
+    /** Create a graph where all nodes are active from arrays in the compressed sparse row format
+     *
+     * @param size number of nodes
+     * @param offsets size + 1 values, the neighbors of u are adjacency[offsets[u]] ... adjacency[offsets[u+1] - 1]
+     * @param adjacency sorted neighbor lists, each edge appears in the lists of both endpoints
+     * @param node_weights
+     * @param is_weighted
+     */
+    CSRGraph(int size, vector<int> offsets, vector<N_ID> adjacency, vector<WTYPE> node_weights, bool is_weighted);
+
+    /** Create a graph where all nodes are active from arrays owned by someone else
+     *
+     * @param owner keeps the arrays alive as long as the graph or one of its copies exists
+     * @see CSRGraph(int, vector<int>, vector<N_ID>, vector<WTYPE>, bool)
+     */
+    CSRGraph(int size, span<const int> offsets, span<const N_ID> adjacency, span<const WTYPE> node_weights, bool is_weighted, shared_ptr<const void> owner);
+
+    bool is_weighted() const { return weighted; };
+    int get_node_number() const { return node_number; };
+    int get_edge_number() const { return edge_number; };
+    bool is_active_node(const N_ID& u) const { return is_active[u]; };
+    const vector<N_ID>& get_active_nodes() const { return active_nodes; };
+
+    int get_degree(const N_ID& u) const { return offsets[u+1] - offsets[u]; };
+    NeighborView get_neighbors(const N_ID& u) const { return {adjacency.data() + offsets[u], adjacency.data() + offsets[u+1]}; };
+
+    WTYPE get_node_weight(const N_ID& u) const { return weights[u]; };
+    WTYPE get_nodeset_weight(const N_CONTAINER& set) const { WTYPE res = 0; for(const auto& u: set) res += weights[u]; return res; };
+
+    /** Computes the largest absolute weight of an active node in the graph
+     *
+     * @return 1 for unweighted graphs
+     */
+    WTYPE get_max_weight() const;
+
+    /** Check the adjacency with the bit matrix for dense graphs and with a binary search in the shortest of two neighbor lists otherwise
+     *
+     * @param u
+     * @param v
+     * @return
+     */
+    bool has_edge(const N_ID& u, const N_ID& v) const;
+
+    /** True if the snapshot stores the bit adjacency matrix
+     *
+     * The graph is dense if the density of its active part is at least DENSE_THRESHOLD, the matrix is built when a row or an edge
+     * is first read, short-lived snapshots that are only walked by neighbors never build it
+     */
+    bool is_dense() const { return dense_adjacency != nullptr; };
+
+    /** The row of the bit adjacency matrix, may be used only if is_dense()
+     *
+     * @param u
+     * @return get_row_words() words, the bit v is set iff u and v are adjacent
+     */
+    const BITWORD* get_adjacency_row(const N_ID& u) const { return adjacency_matrix().row(u); };
+    int get_row_words() const { return adjacency_matrix().get_row_words(); };
+
+    /** The raw arrays of the compressed sparse row format, used to store or convert the graph
+     *
+     */
+    span<const int> get_offsets() const { return offsets; };
+    span<const N_ID> get_adjacency() const { return adjacency; };
+    span<const WTYPE> get_weights() const { return weights; };
+};
+
+/** Check that no two nodes of the set are adjacent
+ *
+ * Dense graphs intersect the adjacency rows with the bitmask of the set, otherwise the set is marked in a scratch array
+ * and the neighbors of each node are walked once. Safe to call from several threads.
+ *
+ * @param G
+ * @param IS
+ * @return false if two nodes are adjacent
+ * @throw invalid_argument if a node of the set isn't an active node of G
+ */
+bool is_independent_set(const CSRGraph& G, const N_CONTAINER& IS);
+
+#endif //QUANTUM_BNP_CSRGRAPH_H
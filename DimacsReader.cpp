@@ -0,0 +1,265 @@
+//
+// Created on 17/10/26.
+//
+
+#include "DimacsReader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <charconv>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+namespace {
+
+/** Edges and weights read from a part of the file
+ *
+ */
+struct ChunkContent {
+    vector<pair<N_ID, N_ID>> edges;
+    vector<pair<N_ID, WTYPE>> weights;
+    int line_number = 0; // number of lines in the chunk
+
+    // Position of the first error relative to the beginning of the chunk, -1 if the chunk is correct
+    int error_line = -1;
+    string error;
+};
+
+inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline void skip_blanks(const char*& p, const char* end) {
+    while(p < end && is_blank(*p))
+        p++;
+}
+
+/** Parse a non-negative integer token that fits into an int
+ *
+ * @param p is moved after the token
+ * @param end
+ * @param value
+ * @return false if the token is not an integer
+ */
+inline bool parse_int(const char*& p, const char* end, int& value) {
+    skip_blanks(p, end);
+    if(p == end || *p < '0' || *p > '9')
+        return false;
+    long long res = 0;
+    while(p < end && *p >= '0' && *p <= '9') {
+        res = res * 10 + (*p - '0');
+        if(res > INT_MAX)
+            return false;
+        p++;
+    }
+    value = res;
+    return p == end || is_blank(*p);
+}
+
+/** Parse a floating point token, doesn't depend on the locale
+ *
+ * @param p is moved after the token
+ * @param end
+ * @param value
+ * @return false if the token is not a number
+ */
+inline bool parse_double(const char*& p, const char* end, WTYPE& value) {
+    skip_blanks(p, end);
+    if(p < end && *p == '+')
+        p++;
+    auto [ptr, ec] = from_chars(p, end, value);
+    if(ec != errc() || ptr == p)
+        return false;
+    p = ptr;
+    return p == end || is_blank(*p);
+}
+
+/** Parse a word token
+ *
+ * @param p is moved after the token
+ * @param end
+ * @return
+ */
+inline string parse_word(const char*& p, const char* end) {
+    skip_blanks(p, end);
+    const char* start = p;
+    while(p < end && !is_blank(*p))
+        p++;
+    return string(start, p);
+}
+
+inline bool at_line_end(const char*& p, const char* end) {
+    skip_blanks(p, end);
+    return p == end;
+}
+
+inline const char* find_line_end(const char* p, const char* end) {
+    auto res = (const char*) memchr(p, '\n', end - p);
+    return res ? res : end;
+}
+
+inline const char* next_line(const char* line_end, const char* end) {
+    return line_end < end ? line_end + 1 : end;
+}
+
+/** Parse edge and weight lines
+ *
+ * @param begin the beginning of a line
+ * @param end the end of a line or of the file
+ * @param node_number number of nodes declared in the problem line
+ * @param content
+ */
+void parse_chunk(const char* begin, const char* end, int node_number, ChunkContent& content) {
+    const char* line = begin;
+    while(line < end) {
+        const char* line_end = find_line_end(line, end);
+        const char* p = line;
+        content.line_number++;
+        skip_blanks(p, line_end);
+
+        string error;
+        if(p == line_end || *p == 'c') {
+            //Empty lines and comments are skipped
+        }
+        else if(*p == 'e') {
+            int u, v;
+            p++;
+            if(!parse_int(p, line_end, u) || !parse_int(p, line_end, v) || !at_line_end(p, line_end))
+                error = "malformed edge line, expected \"e u v\"";
+            else if(u < 1 || v < 1 || u > node_number || v > node_number)
+                error = "edge endpoint out of range [1, " + to_string(node_number) + "]";
+            else if(u != v)
+                content.edges.push_back({u - 1, v - 1});
+        }
+        else if(*p == 'n') {
+            int u;
+            WTYPE weight;
+            p++;
+            if(!parse_int(p, line_end, u) || !parse_double(p, line_end, weight) || !at_line_end(p, line_end))
+                error = "malformed weight line, expected \"n u weight\"";
+            else if(u < 1 || u > node_number)
+                error = "node out of range [1, " + to_string(node_number) + "]";
+            else
+                content.weights.push_back({u - 1, weight});
+        }
+        else if(*p == 'p')
+            error = "duplicate problem line";
+        else
+            error = string("unknown command '") + *p + "'";
+
+        if(!error.empty()) {
+            content.error_line = content.line_number;
+            content.error = error;
+            return;
+        }
+        line = next_line(line_end, end);
+    }
+}
+
+} // namespace
+
+DimacsInstance parse_dimacs(const string& filename) {
+    MappedFile file(filename);
+    const char* end = file.end();
+    const char* line = file.begin();
+
+    DimacsInstance instance;
+    int declared_edges = 0;
+    int line_number = 0;
+    int problem_line = 0;
+
+    //Comments are allowed before the problem line, the rest of the file can be parsed only when the number of nodes is known
+    while(line < end && problem_line == 0) {
+        const char* line_end = find_line_end(line, end);
+        const char* p = line;
+        line_number++;
+        skip_blanks(p, line_end);
+        if(p < line_end && *p == 'p') {
+            p++;
+            string format = parse_word(p, line_end);
+            if(format.empty() || !parse_int(p, line_end, instance.node_number) || !parse_int(p, line_end, declared_edges) || !at_line_end(p, line_end))
+                throw DimacsError(filename, line_number, "malformed problem line, expected \"p format nodes edges\"");
+            problem_line = line_number;
+        }
+        else if(p < line_end && *p != 'c')
+            throw DimacsError(filename, line_number, "the problem line \"p format nodes edges\" is missing");
+        line = next_line(line_end, end);
+    }
+    if(problem_line == 0)
+        throw DimacsError(filename, line_number, "the problem line \"p format nodes edges\" is missing");
+
+    //Split the rest of the file at line boundaries
+    vector<const char*> bounds = {line};
+    size_t rest = end - bounds[0];
+    int n_chunks = max<size_t>(1, min<size_t>(default_thread_number(), rest / DIMACS_CHUNK_SIZE));
+    for(int i = 1; i < n_chunks; i++) {
+        const char* bound = max(bounds.back(), bounds[0] + rest * i / n_chunks);
+        bound = next_line(find_line_end(bound, end), end);
+        bounds.push_back(bound);
+    }
+    bounds.push_back(end);
+    n_chunks = bounds.size() - 1;
+
+    vector<ChunkContent> chunks(n_chunks);
+    parallel_for(n_chunks, [&](int i){ parse_chunk(bounds[i], bounds[i+1], instance.node_number, chunks[i]); });
+
+    //Report the first error in the file
+    int first_line = line_number;
+    for(const auto& chunk: chunks) {
+        if(chunk.error_line != -1)
+            throw DimacsError(filename, first_line + chunk.error_line, chunk.error);
+        first_line += chunk.line_number;
+    }
+
+    size_t n_edges = 0;
+    for(const auto& chunk: chunks)
+        n_edges += chunk.edges.size();
+    if(n_edges > (size_t) declared_edges)
+        throw DimacsError(filename, problem_line, "the file contains " + to_string(n_edges) + " edges, but the problem line declares " + to_string(declared_edges));
+
+    //Weights, nodes without a weight line have weight 1 in unweighted graphs and 0 otherwise
+    int n = instance.node_number;
+    for(const auto& chunk: chunks)
+        instance.weighted = instance.weighted || !chunk.weights.empty();
+    instance.weights.assign(n, instance.weighted ? 0 : 1);
+    for(const auto& chunk: chunks)
+        for(const auto& [u, weight]: chunk.weights)
+            instance.weights[u] = weight;
+
+    //Bucket the edges by endpoint, then sort and deduplicate each row
+    vector<int> row_start(n + 1, 0);
+    for(const auto& chunk: chunks)
+        for(const auto& [u, v]: chunk.edges) {
+            row_start[u + 1]++;
+            row_start[v + 1]++;
+        }
+    for(int u = 0; u < n; u++)
+        row_start[u + 1] += row_start[u];
+
+    vector<N_ID> buckets(row_start[n]);
+    vector<int> fill = row_start;
+    for(const auto& chunk: chunks)
+        for(const auto& [u, v]: chunk.edges) {
+            buckets[fill[u]++] = v;
+            buckets[fill[v]++] = u;
+        }
+    chunks.clear();
+
+    vector<int> row_size(n);
+    parallel_for(n_chunks, [&](int i){
+        for(int u = (long long) n * i / n_chunks; u < (long long) n * (i + 1) / n_chunks; u++) {
+            auto first = buckets.begin() + row_start[u];
+            auto last = buckets.begin() + row_start[u + 1];
+            sort(first, last);
+            row_size[u] = unique(first, last) - first;
+        }
+    });
+
+    instance.offsets.assign(n + 1, 0);
+    for(int u = 0; u < n; u++)
+        instance.offsets[u + 1] = instance.offsets[u] + row_size[u];
+    instance.adjacency.resize(instance.offsets[n]);
+    for(int u = 0; u < n; u++)
+        copy_n(buckets.begin() + row_start[u], row_size[u], instance.adjacency.begin() + instance.offsets[u]);
+    instance.edge_number = instance.adjacency.size() / 2;
+
+    return instance;
+}
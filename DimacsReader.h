@@ -0,0 +1,55 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_DIMACSREADER_H
+#define QUANTUM_BNP_DIMACSREADER_H
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "Graph.h"
+
+//Files larger than DIMACS_CHUNK_SIZE bytes are split in chunks of at least this size parsed by different threads
+#define DIMACS_CHUNK_SIZE (1 << 22)
+
+/** Error in the content of a DIMACS file
+ *
+ * The message has the format "filename:line: description"
+ */
+class DimacsError : public runtime_error {
+    int line;
+public:
+    DimacsError(const string& filename, int line, const string& message):
+            runtime_error(filename + ":" + to_string(line) + ": " + message), line(line) {};
+
+    int get_line() const { return line; };
+};
+
+/** Content of a DIMACS file with the adjacency in the compressed sparse row format
+ *
+ * Nodes are indexed from 0. Neighbors of each node are sorted, without duplicates and loops.
+ */
+struct DimacsInstance {
+    int node_number = 0;
+    int edge_number = 0;
+    bool weighted = false;
+    vector<WTYPE> weights;
+
+    // The neighbors of u are stored in adjacency[offsets[u]] ... adjacency[offsets[u+1] - 1]
+    vector<int> offsets;
+    vector<N_ID> adjacency;
+};
+
+/** Read a graph in the DIMACS format (see README)
+ *
+ * The file is mapped in memory, large files are parsed in parallel. The adjacency is built in bulk by sorting the edge list.
+ *
+ * @param filename
+ * @return
+ * @throw runtime_error if the file can't be read
+ * @throw DimacsError with the line number if a line is malformed
+ */
+DimacsInstance parse_dimacs(const string& filename);
+
+#endif //QUANTUM_BNP_DIMACSREADER_H
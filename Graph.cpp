@@ -2,22 +2,35 @@
 // Created by margarita on 11/10/22.
 //
 
-#include <fstream>
-#include <iostream>
 #include "Graph.h"
+#include "GraphCache.h"
 #include <algorithm>
 
-#define LINE_SIZE 255
-
 void Graph::init_empty(const int &size) {
     weights.resize(size, 0);
     node_number = size;
+    parent.resize(size);
+    members.resize(size);
     for(int i = 0; i < size; i++) {
-        representors[i] = i;
+        parent[i] = i;
+        members[i] = {i};
         active_nodes.insert(i);
     }
 }
 
+N_ID Graph::find_representor(const N_ID &u) {
+    N_ID root = u;
+    while(parent[root] != root)
+        root = parent[root];
+    N_ID node = u;
+    while(parent[node] != root) {
+        N_ID next = parent[node];
+        parent[node] = root;
+        node = next;
+    }
+    return root;
+}
+
 WTYPE Graph::get_max_weight() const {
     if(! weighted)
         return 1;
@@ -34,7 +47,8 @@ WTYPE Graph::get_max_weight() const {
 }
 
 void Graph::add_node_weight(const N_ID& u, const WTYPE& weight){
-    N_ID u_rep = representors[u];
+    N_ID u_rep = find_representor(u);
+    record_weight(u_rep);
     weights[u_rep] += weight;
 };
 
@@ -43,8 +57,10 @@ void Graph::add_edge(const N_ID& u, const N_ID& v) {
     if (!active_nodes.count(u) || !active_nodes.count(v))
         throw invalid_argument("One of the nodes isn't active");
     else if (u != v) {
-        adj_list[u].insert(v);
+        bool is_new = adj_list[u].insert(v).second;
         adj_list[v].insert(u);
+        if(is_new && trail_enabled)
+            trail.push_back({TRAIL_EDGE, u, v, 0, 0, {}, {}});
     }
 };
 bool Graph::has_edge(const N_ID &u, const N_ID& v) const {
@@ -56,16 +72,29 @@ bool Graph::has_edge(const N_ID &u, const N_ID& v) const {
 };
 
 void Graph::merge_nodes(const N_ID &u, const N_ID& v) {
-    N_ID rep_u = representors.at(u);
-    N_ID rep_v = representors.at(v);
+    N_ID rep_u = find_representor(u);
+    N_ID rep_v = find_representor(v);
 
+    if(rep_u == rep_v)
+        return;
     if(has_edge(rep_u, rep_v))
         throw "Connected nodes can't be merged";
 
+    if(trail_enabled) {
+        TrailEntry entry{TRAIL_MERGE, rep_u, rep_v, 0, members[rep_u].size(), {}, {}};
+        const auto& u_neighbors = get_neighbors(rep_u);
+        for(const auto& w: get_neighbors(rep_v)) {
+            entry.old_neighbors.push_back(w);
+            if(!u_neighbors.count(w))
+                entry.new_neighbors.push_back(w);
+        }
+        trail.push_back(std::move(entry));
+    }
+
     active_nodes.erase(rep_v);
-    for( auto& p: representors )
-        if (p.second == rep_v)
-            p.second = rep_u;
+    parent[rep_v] = rep_u;
+    members[rep_u].insert(members[rep_u].end(), members[rep_v].begin(), members[rep_v].end());
+    vector<N_ID>().swap(members[rep_v]);
 
     adj_list[rep_u].insert(adj_list[rep_v].begin(), adj_list[rep_v].end());
 
@@ -79,9 +108,50 @@ void Graph::merge_nodes(const N_ID &u, const N_ID& v) {
     return;
 };
 
+void Graph::undo_last() {
+    TrailEntry& entry = trail.back();
+    switch (entry.type) {
+        case TRAIL_WEIGHT:
+            weights[entry.u] = entry.old_weight;
+            break;
+        case TRAIL_EDGE:
+            adj_list[entry.u].erase(entry.v);
+            adj_list[entry.v].erase(entry.u);
+            break;
+        case TRAIL_MERGE: {
+            N_ID rep_u = entry.u;
+            N_ID rep_v = entry.v;
+
+            //Nodes merged to rep_v form the tail of rep_u's members, path compression may have redirected them to rep_u
+            auto& u_members = members[rep_u];
+            members[rep_v].assign(u_members.begin() + entry.old_members_size, u_members.end());
+            u_members.resize(entry.old_members_size);
+            for(const auto& w: members[rep_v])
+                parent[w] = rep_v;
+            active_nodes.insert(rep_v);
+
+            for(const auto& w: entry.new_neighbors) {
+                adj_list[w].erase(rep_u);
+                adj_list[rep_u].erase(w);
+            }
+            for(const auto& w: entry.old_neighbors)
+                adj_list[w].insert(rep_v);
+            if(!entry.old_neighbors.empty())
+                adj_list[rep_v] = N_CONTAINER(entry.old_neighbors.begin(), entry.old_neighbors.end());
+            break;
+        }
+    }
+    trail.pop_back();
+}
+
+void Graph::rollback(size_t mark) {
+    while(trail.size() > mark)
+        undo_last();
+}
+
 void Graph::split_nodes(const N_ID &u, const N_ID& v){
-    N_ID rep_u = representors.at(u);
-    N_ID rep_v = representors.at(v);
+    N_ID rep_u = find_representor(u);
+    N_ID rep_v = find_representor(v);
 
     add_edge(rep_u, rep_v);
     return;
@@ -89,10 +159,8 @@ void Graph::split_nodes(const N_ID &u, const N_ID& v){
 
 N_CONTAINER Graph::recover_all_merged_to(const N_CONTAINER &set) {
     N_CONTAINER result = set;
-    for(int i = 0; i < node_number; i++){
-        if (set.count(representors[i]))
-            result.insert(i);
-    }
+    for(const auto& u: set)
+        result.insert(members[u].begin(), members[u].end());
     return result;
 }
 
@@ -106,65 +174,53 @@ void Graph::init_node_weights(const vector<WTYPE>& new_weights) {
             add_node_weight(i, new_weights[i]);
 };
 
-void Graph::read_dimacs(const string& filename) {
-    ifstream file;
-    file.open(filename);
-
-    char c, comment[LINE_SIZE];
-    N_ID u, v;
-    WTYPE weight;
-    int n_nodes, n_edges;
-    weighted = false;
-
-    while (file)
-    {
-        file >> c;
-        switch (c) {
-            case 'c':
-                file.getline(comment, LINE_SIZE);
-                break;
-            case 'p': {
-                file >> comment >> n_nodes >> n_edges;
-                init_empty(n_nodes);
-                edge_number = n_edges;
-                break;
-            }
-            case 'e': {
-                file >> u >> v ;
-                if (n_edges >= 0) {
-                    add_edge(u-1, v-1);
-                    n_edges--;
-                } else {
-                    file.close();
-                    cerr << "No more edges to add.\n";
-                }
-                break;
-            }
-            case 'n': {
-                weighted = true;
-                file  >> u >> weight ;
-                set_node_weight(u-1, weight);
-                break;
-            }
-            default :
-            {
-                cerr << "Unknown command. Reading aborted." << std::endl;
-                file.close();
-                break;
-            }
-        }
-    }
-    if(!weighted){
-        for(int u = 0; u < n_nodes; u++)
-            weights[u] = 1;
-    }
-    file.close();
+void Graph::init_from_adjacency(const int& size, span<const int> offsets, span<const N_ID> adjacency, span<const WTYPE> node_weights, bool is_weighted) {
+    weighted = is_weighted;
+    adj_list.clear();
+    parent.clear();
+    members.clear();
+    active_nodes.clear();
+    trail.clear();
+    trail_enabled = false;
+    init_empty(size);
+    weights.assign(node_weights.begin(), node_weights.end());
+
+    //Rows are sorted, so the sets are built in linear time
+    for(int u = 0; u < size; u++)
+        if(offsets[u] != offsets[u+1])
+            adj_list[u] = N_CONTAINER(adjacency.begin() + offsets[u], adjacency.begin() + offsets[u+1]);
+    edge_number = adjacency.size() / 2;
+}
+
+void Graph::read_dimacs(const string& filename, bool use_cache) {
+    init_from_csr(load_graph(filename, use_cache));
 };
 
+void Graph::init_from_csr(const CSRGraph& graph) {
+    init_from_adjacency(graph.get_node_number(), graph.get_offsets(), graph.get_adjacency(), graph.get_weights(), graph.is_weighted());
+}
+
 bool is_independent_set(const Graph& G, const N_CONTAINER& IS){
+    //Scratch marks of the set, all zero between calls, reused by later calls of the same thread
+    thread_local vector<char> in_set;
+    if((int) in_set.size() < G.get_node_number())
+        in_set.resize(G.get_node_number(), 0);
+
+    const auto& active_nodes = G.get_active_nodes();
+    for(const auto & u: IS)
+        if(u < 0 || u >= G.get_node_number() || !active_nodes.count(u))
+            throw invalid_argument("The node " + to_string(u) + " isn't active");
+
     for(const auto & u: IS)
-        for( const auto & v: IS)
-            if (u!=v & G.has_edge(u, v))
-                return false;
-    return true;
-}
\ No newline at end of file
+        in_set[u] = 1;
+    bool independent = true;
+    for(auto it = IS.begin(); independent && it != IS.end(); it++)
+        for(const auto & v: G.get_neighbors(*it))
+            if(in_set[v]) {
+                independent = false;
+                break;
+            }
+    for(const auto & u: IS)
+        in_set[u] = 0;
+    return independent;
+}
@@ -9,6 +9,8 @@
 #include <set>
 #include <unordered_map>
 #include <stdexcept>
+#include <limits>
+#include <span>
 
 using namespace std;
 
@@ -27,6 +29,8 @@ using WTYPE = double;
 //Type of node lists
 using N_CONTAINER = set<N_ID>;
 
+class CSRGraph;
+
 //Graph without loops
 class Graph {
 private:
@@ -40,8 +44,48 @@ private:
     // The indexes of nodes that were not merged to others
     N_CONTAINER active_nodes;
 
-    // If representator[u] != u than the node u was merged to representator[u]
-    unordered_map<N_ID, N_ID> representors;
+    // Union-find forest of merged nodes: parent[u] == u if u is a representor, otherwise u was merged to the representor of parent[u]
+    vector<N_ID> parent;
+
+    // For each representor the list of nodes merged to it (itself included), empty for other nodes
+    vector<vector<N_ID>> members;
+
+    /** Find the representor of a node and compress the path to it
+     *
+     * @param u
+     * @return
+     */
+    N_ID find_representor(const N_ID& u);
+
+    enum TrailType {
+        TRAIL_MERGE,   // rep_v was merged to rep_u
+        TRAIL_EDGE,    // the edge (u, v) was added
+        TRAIL_WEIGHT   // the weight of u was changed
+    };
+
+    /** A modification of the graph that can be undone
+     *
+     */
+    struct TrailEntry {
+        TrailType type;
+        N_ID u;
+        N_ID v;
+        WTYPE old_weight; // TRAIL_WEIGHT: the weight before the modification
+        size_t old_members_size; // TRAIL_MERGE: the number of nodes merged to rep_u before the merge
+        vector<N_ID> old_neighbors; // TRAIL_MERGE: neighbors of rep_v
+        vector<N_ID> new_neighbors; // TRAIL_MERGE: neighbors of rep_v that were not neighbors of rep_u
+    };
+
+    // Undo log of modifications, is filled only after the first checkpoint
+    vector<TrailEntry> trail;
+    bool trail_enabled = false;
+
+    void record_weight(const N_ID& u) { if (trail_enabled) trail.push_back({TRAIL_WEIGHT, u, -1, weights[u], 0, {}, {}}); };
+
+    /** Undo the last entry of the trail
+     *
+     */
+    void undo_last();
 
     /** Create an empty graph
      *
@@ -54,8 +98,8 @@ public:
     int get_node_number() const { return node_number; };
     int get_edge_number() const { return edge_number; };
     int get_degree(const N_ID& u) const { if (!active_nodes.count(u)) throw invalid_argument("The node isn't active"); else return adj_list.at(u).size(); };
-    N_CONTAINER get_neighbors(const N_ID& u) const { const std::set<int> emptyReturn; return (adj_list.find(u) != adj_list.end()) ? adj_list.at(u) : emptyReturn;}
-    N_CONTAINER get_active_nodes() const { return  active_nodes; };
+    const N_CONTAINER& get_neighbors(const N_ID& u) const { static const N_CONTAINER emptyReturn; auto it = adj_list.find(u); return (it != adj_list.end()) ? it->second : emptyReturn;}
+    const N_CONTAINER& get_active_nodes() const { return  active_nodes; };
 
     WTYPE get_node_weight(const N_ID& u) const { if (!active_nodes.count(u)) throw invalid_argument("The node isn't active"); else return weights.at(u); } ;
     WTYPE get_nodeset_weight(const N_CONTAINER& set) const { WTYPE res = 0; for(const auto& u: set) res += get_node_weight(u); return res; }
@@ -72,7 +116,7 @@ public:
      */
     WTYPE get_surplus(const N_ID& u) const { auto w = get_node_weight(u); for(const auto & v: adj_list.at(u)) w -= get_node_weight(v); return w; };
 
-    void set_weights_to_zero() {fill(weights.begin(), weights.end(), 0); }
+    void set_weights_to_zero() { for(int u = 0; u < node_number; u++) if (weights[u] != 0) { record_weight(u); weights[u] = 0; } }
 
     /** Set the new weight to an active node
      *
@@ -80,7 +124,7 @@ public:
      * @param weight
      * @throw invalid_argument if the node u isn't active
      */
-    void set_node_weight(const N_ID& u, const WTYPE& weight) { if (!active_nodes.count(u)) throw invalid_argument("The node isn't active"); else weights[u] = weight; };
+    void set_node_weight(const N_ID& u, const WTYPE& weight) { if (!active_nodes.count(u)) throw invalid_argument("The node isn't active"); else { record_weight(u); weights[u] = weight; } };
 
     /** Add the weight of an inactive node to the weight of its representor
      *
@@ -96,7 +140,7 @@ public:
     /** Merge the nodes u and v
      *
      * u and v get the same representor. The method merges all nodes previously merged to v (v included) to the representor of u.
-     * The number of active nodes decreases
+     * The number of active nodes decreases. Costs O(degree of the representor of v + number of nodes merged to it).
      *
      * @param u
      * @param v
@@ -120,21 +164,66 @@ public:
      */
     void init_node_weights(const vector<WTYPE>& new_weights);
 
+    /** Initialize the graph from adjacency lists in the compressed sparse row format
+     *
+     * @param size number of nodes
+     * @param offsets the neighbors of u are adjacency[offsets[u]] ... adjacency[offsets[u+1] - 1]
+     * @param adjacency sorted neighbor lists, each edge appears in the lists of both endpoints
+     * @param node_weights
+     * @param is_weighted
+     */
+    void init_from_adjacency(const int& size, span<const int> offsets, span<const N_ID> adjacency, span<const WTYPE> node_weights, bool is_weighted);
+
+    /** Initialize the graph from a snapshot where all nodes are active
+     *
+     * @param graph
+     */
+    void init_from_csr(const CSRGraph& graph);
+
     /** Initialize the edge lists end the node weights from a file
      *
-     * @param filename
-     * @throw TODO (and exception if the filename is invalid or the file doesn't respect the DIMACS format)
+     * @param filename a DIMACS file or a binary graph file (see GraphCache.h)
+     * @param use_cache if true a DIMACS file is read from its binary sidecar when it is up to date, otherwise the sidecar is written
+     * next to the file. Off by default, so that reading never writes to the data directory
+     * @throw runtime_error if the file can't be read
+     * @throw DimacsError with the line number if the file doesn't respect the DIMACS format
+     */
+    void read_dimacs(const string& filename, bool use_cache = false);
+
+    /** Mark the current state of the graph
+     *
+     * After the first call every merge, split, added edge and weight modification is recorded in an undo log
+     *
+     * @return a mark that can be passed to rollback
+     */
+    size_t checkpoint() { trail_enabled = true; return trail.size(); };
+
+    /** Undo all modifications made after the checkpoint, the most recent first
+     *
+     * @param mark a value returned by checkpoint, marks taken after it become invalid
+     * @note costs O(size of the undone modifications)
      */
-    void read_dimacs(const string& filename);
+    void rollback(size_t mark);
 
     /** Find all nodes that are merged to nodes in the input container
      *
-     * @param set
+     * @param set representors
      * @return
+     * @note costs O(size of the result)
      */
     N_CONTAINER recover_all_merged_to(const N_CONTAINER& set);
 };
 
+/** Check that no two nodes of the set are adjacent
+ *
+ * Marks the set in a scratch array and walks the neighbors of each node once, costs O(|IS| log n + sum of the degrees).
+ * Safe to call from several threads.
+ *
+ * @param G
+ * @param IS
+ * @return false if two nodes are adjacent
+ * @throw invalid_argument if a node of the set isn't an active node of G
+ */
 bool is_independent_set(const Graph& G, const N_CONTAINER& IS);
 
 #endif //QUANTUM_BNP_GRAPH_H
@@ -0,0 +1,211 @@
+//
+// Created on 17/10/26.
+//
+
+#include "GraphCache.h"
+#include "MappedFile.h"
+#include "DimacsReader.h"
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <climits>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char GRAPH_BINARY_MAGIC[8] = {'Q', 'B', 'N', 'P', 'G', 'R', 'P', 'H'};
+
+/** Header of a binary graph file, the arrays start at the given byte positions (multiples of 8)
+ *
+ */
+struct GraphBinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t weighted;
+    uint64_t node_number;
+    uint64_t adjacency_size;
+    uint64_t offsets_position;
+    uint64_t adjacency_position;
+    uint64_t weights_position;
+    SourceKey source;
+};
+
+uint64_t align8(uint64_t position) { return (position + 7) / 8 * 8; }
+
+/** 64-bit FNV-1a hash applied to 8-byte words, the tail is hashed byte by byte
+ *
+ */
+uint64_t hash_content(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    const uint64_t prime = 1099511628211ULL;
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for(; i < size; i++)
+        hash = (hash ^ (unsigned char) data[i]) * prime;
+    return hash;
+}
+
+bool ends_with(const string& s, const string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/** Read the size and the modification time of a file
+ *
+ * @return false if the file doesn't exist
+ */
+bool stat_file(const string& filename, SourceKey& key) {
+    struct stat info;
+    if(stat(filename.c_str(), &info) < 0)
+        return false;
+    key.size = info.st_size;
+    key.mtime = (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    return true;
+}
+
+} // namespace
+
+SourceKey get_source_key(const string& filename) {
+    SourceKey key;
+    if(!stat_file(filename, key))
+        throw runtime_error("Can't read " + filename);
+    MappedFile file(filename);
+    key.hash = hash_content(file.begin(), file.size());
+    return key;
+}
+
+void write_graph_binary(const string& filename, const CSRGraph& graph, const SourceKey& source) {
+    if((int) graph.get_active_nodes().size() != graph.get_node_number())
+        throw invalid_argument("Only graphs without merged nodes can be stored");
+
+    auto offsets = graph.get_offsets();
+    auto adjacency = graph.get_adjacency();
+    auto weights = graph.get_weights();
+
+    GraphBinaryHeader header{};
+    memcpy(header.magic, GRAPH_BINARY_MAGIC, sizeof(header.magic));
+    header.version = GRAPH_BINARY_VERSION;
+    header.weighted = graph.is_weighted();
+    header.node_number = graph.get_node_number();
+    header.adjacency_size = adjacency.size();
+    header.offsets_position = align8(sizeof(header));
+    header.adjacency_position = align8(header.offsets_position + offsets.size_bytes());
+    header.weights_position = align8(header.adjacency_position + adjacency.size_bytes());
+    header.source = source;
+
+    ofstream file(filename, ios::binary | ios::trunc);
+    if(!file)
+        throw runtime_error("Can't write " + filename);
+
+    auto write_at = [&file](uint64_t position, const void* data, size_t size){
+        const char zeros[8] = {};
+        file.write(zeros, position - file.tellp());
+        file.write((const char*) data, size);
+    };
+    write_at(0, &header, sizeof(header));
+    write_at(header.offsets_position, offsets.data(), offsets.size_bytes());
+    write_at(header.adjacency_position, adjacency.data(), adjacency.size_bytes());
+    write_at(header.weights_position, weights.data(), weights.size_bytes());
+
+    if(!file)
+        throw runtime_error("Can't write " + filename);
+}
+
+CSRGraph map_graph_binary(const string& filename, SourceKey* source) {
+    auto file = make_shared<MappedFile>(filename);
+
+    GraphBinaryHeader header;
+    if(file->size() < sizeof(header))
+        throw runtime_error(filename + " is not a binary graph file");
+    memcpy(&header, file->begin(), sizeof(header));
+    if(memcmp(header.magic, GRAPH_BINARY_MAGIC, sizeof(header.magic)) != 0)
+        throw runtime_error(filename + " is not a binary graph file");
+    if(header.version != GRAPH_BINARY_VERSION)
+        throw runtime_error(filename + " has the binary format version " + to_string(header.version) + ", expected " + to_string(GRAPH_BINARY_VERSION));
+
+    uint64_t n = header.node_number;
+    if(n >= INT_MAX || header.adjacency_size >= INT_MAX || header.offsets_position > file->size() ||
+       header.adjacency_position > file->size() || header.weights_position > file->size())
+        throw runtime_error(filename + " is truncated or corrupted");
+    //The mapping starts on a page boundary, the arrays are read in place only if their positions keep them aligned
+    if(header.offsets_position % 8 != 0 || header.adjacency_position % 8 != 0 || header.weights_position % 8 != 0)
+        throw runtime_error(filename + " is corrupted: misaligned arrays");
+    if(header.offsets_position + (n + 1) * sizeof(int) > header.adjacency_position ||
+       header.adjacency_position + header.adjacency_size * sizeof(N_ID) > header.weights_position ||
+       header.weights_position + n * sizeof(WTYPE) > file->size())
+        throw runtime_error(filename + " is truncated or corrupted");
+
+    span<const int> offsets((const int*) (file->begin() + header.offsets_position), n + 1);
+    span<const N_ID> adjacency((const N_ID*) (file->begin() + header.adjacency_position), header.adjacency_size);
+    span<const WTYPE> weights((const WTYPE*) (file->begin() + header.weights_position), n);
+    if(offsets[0] != 0 || offsets[n] != (int64_t) header.adjacency_size)
+        throw runtime_error(filename + " is truncated or corrupted");
+    //Rows must be strictly increasing, has_edge searches them with a binary search
+    for(uint64_t u = 0; u < n; u++) {
+        if(offsets[u] > offsets[u + 1])
+            throw runtime_error(filename + " is corrupted: the offsets of node " + to_string(u) + " decrease");
+        for(int k = offsets[u]; k < offsets[u + 1]; k++) {
+            N_ID v = adjacency[k];
+            if(v < 0 || (uint64_t) v >= n)
+                throw runtime_error(filename + " is corrupted: invalid neighbor " + to_string(v));
+            if(k > offsets[u] && adjacency[k - 1] >= v)
+                throw runtime_error(filename + " is corrupted: the neighbors of node " + to_string(u) + " are not sorted");
+        }
+    }
+
+    if(source)
+        *source = header.source;
+    return CSRGraph(n, offsets, adjacency, weights, header.weighted, std::move(file));
+}
+
+CSRGraph load_graph(const string& filename, bool use_cache) {
+    if(ends_with(filename, GRAPH_BINARY_EXTENSION))
+        return map_graph_binary(filename);
+
+    string cache_file = filename + GRAPH_BINARY_EXTENSION;
+    SourceKey key;
+    bool key_computed = false;
+    if(use_cache) {
+        SourceKey cached_key;
+        SourceKey stat_key;
+        if(stat_file(cache_file, cached_key) && stat_file(filename, stat_key)) {
+            try {
+                CSRGraph graph = map_graph_binary(cache_file, &cached_key);
+                //The hash is computed only if the cheap checks pass
+                if(cached_key.size == stat_key.size && cached_key.mtime == stat_key.mtime) {
+                    key = get_source_key(filename);
+                    key_computed = true;
+                    if(key == cached_key)
+                        return graph;
+                }
+            }
+            catch (const runtime_error&) {
+                //Outdated or broken cache file, it is rebuilt below
+            }
+        }
+    }
+
+    DimacsInstance instance = parse_dimacs(filename);
+    CSRGraph graph(instance.node_number, std::move(instance.offsets), std::move(instance.adjacency), std::move(instance.weights), instance.weighted);
+
+    if(use_cache) {
+        //Write to a temporary file first, so that concurrent runs never map a partially written cache
+        string tmp_file = cache_file + ".tmp" + to_string(getpid());
+        try {
+            if(!key_computed)
+                key = get_source_key(filename);
+            write_graph_binary(tmp_file, graph, key);
+            if(rename(tmp_file.c_str(), cache_file.c_str()) != 0)
+                remove(tmp_file.c_str());
+        }
+        catch (const exception&) {
+            //The cache is optional, e.g. the directory may be read-only
+            remove(tmp_file.c_str());
+        }
+    }
+    return graph;
+}
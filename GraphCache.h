@@ -0,0 +1,77 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_GRAPHCACHE_H
+#define QUANTUM_BNP_GRAPHCACHE_H
+
+#include <cstdint>
+#include <string>
+#include "CSRGraph.h"
+
+//Extension of binary graph files, the cache of "instance.mwis" is stored in "instance.mwis.qbg"
+#define GRAPH_BINARY_EXTENSION ".qbg"
+
+//Version of the binary format, files with another version are ignored by the cache and rejected by map_graph_binary
+#define GRAPH_BINARY_VERSION 1
+
+/** Identifies the content of the text file a binary graph was created from
+ *
+ */
+struct SourceKey {
+    uint64_t size = 0;
+    int64_t mtime = 0; // modification time in nanoseconds
+    uint64_t hash = 0;
+
+    bool operator==(const SourceKey&) const = default;
+};
+
+/** Compute the key of a file from its size, modification time and a 64-bit hash of its content
+ *
+ * @param filename
+ * @return
+ * @throw runtime_error if the file can't be read
+ */
+SourceKey get_source_key(const string& filename);
+
+/** Write the graph in the binary format
+ *
+ * The file contains a versioned header followed by the offsets, the neighbor array and the weights in the compressed sparse row format.
+ * Only graphs where all nodes are active can be stored.
+ *
+ * @param filename
+ * @param graph
+ * @param source the key of the text file the graph was read from, zero if there is no such file
+ * @throw runtime_error if the file can't be written
+ */
+void write_graph_binary(const string& filename, const CSRGraph& graph, const SourceKey& source = {});
+
+/** Map a binary graph file in memory, the arrays of the returned graph point directly into the mapping
+ *
+ * @param filename
+ * @param source if not null, stores the key of the text file the graph was created from
+ * The arrays are checked to be 8-byte aligned, the offsets to be non-decreasing and the rows to be strictly increasing lists of
+ * valid nodes, so that a corrupted file never leads to reads out of the mapping or to wrong adjacency tests. This takes one pass
+ * over the arrays.
+ *
+ * @return
+ * @throw runtime_error if the file can't be read or is not a valid binary graph of the current version
+ */
+CSRGraph map_graph_binary(const string& filename, SourceKey* source = nullptr);
+
+/** Load a graph from a binary file or from a DIMACS file with a transparent binary cache
+ *
+ * Files with the GRAPH_BINARY_EXTENSION are mapped directly. For DIMACS files, the sidecar file filename + GRAPH_BINARY_EXTENSION
+ * is mapped if its key matches the size, the modification time and the hash of the text file.
+ * Otherwise the text is parsed and the sidecar is (re)written, failures to write it are ignored.
+ *
+ * @param filename
+ * @param use_cache if false the text file is always parsed and no sidecar is written, so that the directory of the file is never
+ * modified unless the caller asks for it
+ * @return
+ * @throw runtime_error if the file can't be read
+ * @throw DimacsError if the DIMACS file is malformed
+ */
+CSRGraph load_graph(const string& filename, bool use_cache = false);
+
+#endif //QUANTUM_BNP_GRAPHCACHE_H
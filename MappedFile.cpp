@@ -0,0 +1,42 @@
+//
+// Created on 17/10/26.
+//
+
+#include "MappedFile.h"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile(const string& filename): data(nullptr), length(0) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw runtime_error("Can't open " + filename + ": " + strerror(errno));
+
+    struct stat info;
+    if(fstat(fd, &info) < 0) {
+        close(fd);
+        throw runtime_error("Can't read the size of " + filename + ": " + strerror(errno));
+    }
+    length = info.st_size;
+
+    //Empty files can't be mapped, they are represented by an empty range
+    if(length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("Can't map " + filename + ": " + strerror(errno));
+        }
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        data = (const char*) mapping;
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if(data)
+        munmap((void*) data, length);
+}
@@ -0,0 +1,38 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_MAPPEDFILE_H
+#define QUANTUM_BNP_MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+/** Read-only memory mapping of a whole file
+ *
+ * The mapping is released when the object is destroyed
+ */
+class MappedFile {
+    const char* data;
+    size_t length;
+
+public:
+    /** Map the file in memory
+     *
+     * @param filename
+     * @throw runtime_error if the file can't be opened or mapped
+     */
+    explicit MappedFile(const string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const { return data; };
+    const char* end() const { return data + length; };
+    size_t size() const { return length; };
+};
+
+#endif //QUANTUM_BNP_MAPPEDFILE_H
@@ -0,0 +1,71 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_PARALLEL_H
+#define QUANTUM_BNP_PARALLEL_H
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <mutex>
+
+using namespace std;
+
+/** Number of threads used by parallel routines when the caller doesn't specify it
+ *
+ * @return the number of hardware threads, at least 1
+ */
+inline int default_thread_number() {
+    unsigned n = thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+/** Call f(i) for every i in [0, n_tasks) on a pool of threads
+ *
+ * Tasks are distributed dynamically, the calling thread takes part in the work. The function returns when all tasks are done.
+ * If a task throws, the tasks that have not started yet are skipped and the first exception is rethrown after all threads joined.
+ *
+ * @param n_tasks
+ * @param f
+ * @param n_threads maximal number of threads
+ */
+template<class F>
+void parallel_for(int n_tasks, F f, int n_threads = default_thread_number()) {
+    n_threads = min(n_threads, n_tasks);
+    if(n_threads <= 1) {
+        for(int i = 0; i < n_tasks; i++)
+            f(i);
+        return;
+    }
+
+    atomic<int> next_task(0);
+    exception_ptr error;
+    mutex error_mutex;
+    auto worker = [&next_task, &f, &error, &error_mutex, n_tasks](){
+        for(int i = next_task++; i < n_tasks; i = next_task++) {
+            try {
+                f(i);
+            }
+            catch(...) {
+                lock_guard<mutex> lock(error_mutex);
+                if(!error)
+                    error = current_exception();
+                next_task = n_tasks;
+            }
+        }
+    };
+
+    vector<thread> pool;
+    for(int t = 1; t < n_threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for(auto& t: pool)
+        t.join();
+    if(error)
+        rethrow_exception(error);
+}
+
+#endif //QUANTUM_BNP_PARALLEL_H
@@ -0,0 +1,104 @@
+//
+// Created on 17/10/26.
+//
+
+#include "Settings.h"
+#include <climits>
+#include <algorithm>
+
+namespace {
+
+// True if --bf_limit was given, check_settings keeps it whatever the depth is
+bool bf_limit_given = false;
+
+int parse_int_value(const string& name, const string& value, int min_value, int max_value = INT_MAX) {
+    size_t end = 0;
+    int res;
+    try {
+        res = stoi(value, &end);
+    }
+    catch (const exception&) {
+        end = 0;
+    }
+    if(end == 0 || end != value.size() || res < min_value || res > max_value)
+        throw invalid_argument("Invalid value of " + name + ": " + value + ", expected an integer >= " + to_string(min_value)
+                               + (max_value < INT_MAX ? " and <= " + to_string(max_value) : ""));
+    return res;
+}
+
+double parse_double_value(const string& name, const string& value, double min_value) {
+    size_t end = 0;
+    double res;
+    try {
+        res = stod(value, &end);
+    }
+    catch (const exception&) {
+        end = 0;
+    }
+    if(end == 0 || end != value.size() || !(res >= min_value))
+        throw invalid_argument("Invalid value of " + name + ": " + value + ", expected a number >= " + to_string(min_value));
+    return res;
+}
+
+QAOAOptimizer parse_optimizer_value(const string& name, const string& value) {
+    if(value == "lbfgs")
+        return QAOA_OPTIMIZER_LBFGS;
+    if(value == "mma")
+        return QAOA_OPTIMIZER_MMA;
+    if(value == "bobyqa")
+        return QAOA_OPTIMIZER_BOBYQA;
+    throw invalid_argument("Invalid value of " + name + ": " + value + ", expected lbfgs, mma or bobyqa");
+}
+
+} // namespace
+
+Settings& settings() {
+    static Settings global_settings;
+    return global_settings;
+}
+
+void parse_setting(const string& arg) {
+    size_t eq = arg.find('=');
+    if(arg.rfind("--", 0) != 0 || eq == string::npos)
+        throw invalid_argument("Invalid option " + arg + ", expected --name=value");
+    string name = arg.substr(2, eq - 2);
+    string value = arg.substr(eq + 1);
+
+    Settings& s = settings();
+    if(name == "threads")
+        s.threads = parse_int_value(name, value, 1);
+    else if(name == "greedy_random_starts")
+        s.greedy_random_starts = parse_int_value(name, value, 0);
+    else if(name == "seed")
+        s.seed = parse_int_value(name, value, 0);
+    else if(name == "ils_time")
+        s.ils_time = parse_double_value(name, value, 0);
+    else if(name == "ils_post_time")
+        s.ils_post_time = parse_double_value(name, value, 0);
+    else if(name == "bf_limit") {
+        s.bf_limit = parse_int_value(name, value, 1, BF_MAX_LIMIT);
+        bf_limit_given = true;
+    }
+    else if(name == "qaoa_depth")
+        s.qaoa_depth = parse_int_value(name, value, 1, QAOA_MAX_DEPTH);
+    else if(name == "statevector_limit")
+        s.statevector_limit = parse_int_value(name, value, 1, STATEVECTOR_MAX_LIMIT);
+    else if(name == "rqaoa_batch")
+        s.rqaoa_batch = parse_int_value(name, value, 1);
+    else if(name == "correlation_tolerance")
+        s.correlation_tolerance = parse_double_value(name, value, 0);
+    else if(name == "qaoa_optimizer")
+        s.qaoa_optimizer = parse_optimizer_value(name, value);
+    else
+        throw invalid_argument("Unknown option --" + name);
+}
+
+void check_settings() {
+    Settings& s = settings();
+    if(s.qaoa_depth > 1 && !bf_limit_given)
+        s.bf_limit = min(s.bf_limit, BF_DEEP_LIMIT);
+    if(s.qaoa_depth > 1 && s.statevector_limit <= s.bf_limit)
+        throw invalid_argument("--qaoa_depth=" + to_string(s.qaoa_depth) + " needs statevector_limit > bf_limit, RQAOA simulates the circuit"
+                               " only while the number of variables is between them (statevector_limit = " + to_string(s.statevector_limit)
+                               + ", bf_limit = " + to_string(s.bf_limit) + ")");
+}
@@ -0,0 +1,85 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_SETTINGS_H
+#define QUANTUM_BNP_SETTINGS_H
+
+#include <string>
+#include <stdexcept>
+#include "Parallel.h"
+
+//Number of greedy starts with randomly perturbed priorities, run in addition to the fixed orders
+#define GREEDY_RANDOM_STARTS 8
+
+//Priorities of randomized greedy starts are multiplied by a factor drawn uniformly from [1 - GREEDY_PERTURBATION, 1 + GREEDY_PERTURBATION]
+#define GREEDY_PERTURBATION 0.1
+
+//Time budget in seconds of the iterated local search method (-ils)
+#define ILS_TIME 1.0
+
+//RQAOA recomputes all correlations when beta or gamma moved by more than CORRELATION_TOLERANCE since the last full refresh
+#define CORRELATION_TOLERANCE 0.001
+
+//RQAOA solves the remaining problem by brute force when at most BF_LIMIT variables are left, the limit can be raised up to BF_MAX_LIMIT
+#define BF_LIMIT 24
+#define BF_MAX_LIMIT 30
+
+//With --qaoa_depth > 1, RQAOA simulates the state vector of the circuit once at most STATEVECTOR_LIMIT variables are left and
+//until the brute-force limit is reached. The state vector takes 20 bytes per amplitude, 84 MB for STATEVECTOR_LIMIT variables
+//and 1.3 GB for STATEVECTOR_MAX_LIMIT variables
+#define STATEVECTOR_LIMIT 22
+#define STATEVECTOR_MAX_LIMIT 26
+
+//Brute-force limit used instead of BF_LIMIT when --qaoa_depth > 1 and --bf_limit is not given, the deeper circuit then eliminates
+//STATEVECTOR_LIMIT - BF_DEEP_LIMIT variables
+#define BF_DEEP_LIMIT 16
+
+//Maximal number of layers of the simulated circuits, the initialization optimizes the circuits of every depth up to qaoa_depth
+#define QAOA_MAX_DEPTH 8
+
+/** Local optimizers of the QAOA parameters, the first two use the analytic gradient of the energy
+ *
+ */
+enum QAOAOptimizer {QAOA_OPTIMIZER_LBFGS, QAOA_OPTIMIZER_MMA, QAOA_OPTIMIZER_BOBYQA};
+
+/** Run-time parameters of the methods, the defaults are given by the macros
+ *
+ */
+struct Settings {
+    int threads = default_thread_number(); // maximal number of threads used by parallel routines
+    int greedy_random_starts = GREEDY_RANDOM_STARTS;
+    unsigned seed = 0; // seed of the randomized methods, runs with the same seed and number of threads are reproducible
+    double ils_time = ILS_TIME;
+    double ils_post_time = 0; // time budget in seconds of the iterated local search applied to the results of greedyMWIS and quantumMWIS
+    QAOAOptimizer qaoa_optimizer = QAOA_OPTIMIZER_LBFGS; // local optimizer of the RQAOA parameters, "lbfgs", "mma" or "bobyqa"
+    double correlation_tolerance = CORRELATION_TOLERANCE; // 0 recomputes all correlations whenever the parameters change
+    int bf_limit = BF_LIMIT; // maximal number of variables of the problem solved by brute force at the end of RQAOA
+    int rqaoa_batch = 1; // maximal number of variables eliminated by RQAOA per optimization of the parameters
+    int qaoa_depth = 1; // number of layers of the circuit simulated on the state vector, 1 keeps the analytic QAOA_1 until the brute-force search
+    int statevector_limit = STATEVECTOR_LIMIT; // maximal number of variables of the problem simulated on the state vector
+};
+
+/** The settings shared by the whole program
+ *
+ * @return
+ */
+Settings& settings();
+
+/** Set a parameter from a command line argument of the form "--name=value"
+ *
+ * @param arg
+ * @throw invalid_argument if the name is unknown or the value is malformed
+ */
+void parse_setting(const string& arg);
+
+/** Check the parameters that depend on each other, to be called once all the arguments are parsed
+ *
+ * With qaoa_depth > 1 and no explicit bf_limit, the brute-force limit is lowered to BF_DEEP_LIMIT: the state vector above BF_LIMIT
+ * would take more than 300 MB, a smaller brute-force search leaves a range of variables to the deeper circuit at a moderate memory cost.
+ *
+ * @throw invalid_argument if qaoa_depth > 1 and statevector_limit <= bf_limit, the deeper circuit would never be simulated
+ */
+void check_settings();
+
+#endif //QUANTUM_BNP_SETTINGS_H
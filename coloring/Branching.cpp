@@ -6,6 +6,7 @@
 #include "Vardata.h"
 #include "Probdata.h"
 #include "ConstraintHandler.h"
+#include "../BitMatrix.h"
 
 using NodePair = struct nodePair{
     int u;
@@ -16,6 +17,8 @@ NodePair find_branching_constraint(Scip* scip, SCIP_VAR** fractional_vars, SCIP_
 
     vector<vector<SCIP_Real>> pair_values(node_number, vector<WTYPE>(node_number, 0)); // An array containing sum of fractional
 
+    BitMatrix covered_together(node_number); // Pairs of nodes that belong to the same independent set of at least one fractional variable
+
     //Fill in the table
     for(int i = 0; i < nfractional; i++){
 
@@ -26,8 +29,10 @@ NodePair find_branching_constraint(Scip* scip, SCIP_VAR** fractional_vars, SCIP_
         N_CONTAINER independent_set = vardata->get_independent_set();
 
         for(const auto& u : independent_set){
-            for(const auto& v: independent_set)
+            for(const auto& v: independent_set) {
                 pair_values[u][v] += val;
+                covered_together.set(u, v);
+            }
         }
     }
 
@@ -35,8 +40,11 @@ NodePair find_branching_constraint(Scip* scip, SCIP_VAR** fractional_vars, SCIP_
     NodePair branching_pair = {-1, 1};
     SCIP_Real value, bestvalue = 0;
 
+    //Pairs that are never covered together have zero value and can't be selected, only the set bits are visited
     for(int i = 0; i < node_number; i++)
-        for(int j = i+1; j < node_number; j++){
+        for_each_bit(covered_together.row(i), covered_together.get_row_words(), [&](int j){
+            if(j <= i)
+                return;
 
             //Measure the "fractionality" of the pair interaction
             value = MIN(pair_values[i][j], 1 - pair_values[i][j]);
@@ -49,7 +57,7 @@ NodePair find_branching_constraint(Scip* scip, SCIP_VAR** fractional_vars, SCIP_
                     bestvalue = value;
                     branching_pair = {i, j};
                 }
-        }
+        });
 
     return branching_pair;
 }
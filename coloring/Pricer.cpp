@@ -9,33 +9,48 @@
 #include "Vardata.h"
 #include "ConstraintHandler.h"
 #include "Probdata.h"
+#include "../mwis/Reductions.h"
 
 
 SCIP_RETCODE Pricer::add_branching_constraints() {
     if(branching_accounted)
         throw "Branching constraint was already integrated";
 
-    local_graph = *initial_graph;
-
     auto constraint_set = SCIPconshdlrGetConss(conshdlr);
     auto n_conss = SCIPconshdlrGetNConss(conshdlr);
 
-    SCIP_CONS* constraint;
-
+    vector<SameDiff> active_constraints;
     for(int i = 0; i < n_conss; i++){
-        constraint = constraint_set[i];
-
-        if(!SCIPconsIsActive(constraint))
+        if(!SCIPconsIsActive(constraint_set[i]))
             continue;
 
-        SameDiff* cons_data = (SameDiff *) SCIPconsGetData(constraint);
+        SameDiff* cons_data = (SameDiff *) SCIPconsGetData(constraint_set[i]);
+        if(cons_data->type != MERGE && cons_data->type != SPLIT)
+            return SCIP_INVALIDDATA;
+        active_constraints.push_back(*cons_data);
+    }
+
+    //Keep the longest common prefix with the constraints of the previous node
+    size_t common = 0;
+    while(common < applied_constraints.size() && common < active_constraints.size()){
+        const SameDiff& applied = applied_constraints[common].first;
+        const SameDiff& active = active_constraints[common];
+        if(applied.u != active.u || applied.v != active.v || applied.type != active.type)
+            break;
+        common++;
+    }
+    if(common < applied_constraints.size()){
+        local_graph.rollback(applied_constraints[common].second);
+        applied_constraints.resize(common);
+    }
 
-        if(cons_data->type == MERGE)
-            local_graph.merge_nodes(cons_data->u, cons_data->v);
-        else if(cons_data->type == SPLIT)
-            local_graph.split_nodes(cons_data->u, cons_data->v);
+    for(size_t i = common; i < active_constraints.size(); i++){
+        const SameDiff& cons_data = active_constraints[i];
+        applied_constraints.push_back({cons_data, local_graph.checkpoint()});
+        if(cons_data.type == MERGE)
+            local_graph.merge_nodes(cons_data.u, cons_data.v);
         else
-            return SCIP_INVALIDDATA;
+            local_graph.split_nodes(cons_data.u, cons_data.v);
     }
 
     branching_accounted = true;
@@ -82,12 +97,19 @@ SCIP_DECL_PRICERINIT(Pricer::scip_init){
 }
 
 SCIP_DECL_PRICERREDCOST(Pricer::scip_redcost){
+    //Weights are recorded after the branching changes, undo them first
+    if(weights_set)
+        local_graph.rollback(weights_mark);
+    weights_set = false;
+
     if(!branching_accounted)
         add_branching_constraints();
 
     //Initialize weights from dual values
 
     WTYPE dual;
+    weights_mark = local_graph.checkpoint();
+    weights_set = true;
     local_graph.set_weights_to_zero();
     for(int u = 0; u < covering_constraints.size(); u++){
         dual = SCIPgetDualsolSetppc(scip, covering_constraints[u]);
@@ -102,20 +124,34 @@ SCIP_DECL_PRICERREDCOST(Pricer::scip_redcost){
     N_CONTAINER mwis;
     WTYPE mwis_value = 0;
 
-    //Search for an improving independent se(t
-    found = greedyMWIS(local_graph, mwis, mwis_value, cutoff);
+    //Search for an improving independent set on the reduced graph, the methods are tried from the cheapest.
+    //The graph is reduced once, all methods run on the same kernel with the cutoff decreased by the weight fixed by the reductions
+    CSRGraph pricing_graph(local_graph);
+    MWISReducer reducer(pricing_graph);
+    reducer.reduce();
+    CSRGraph kernel = reducer.get_kernel();
+    WTYPE kernel_cutoff = cutoff - reducer.get_offset();
+    found = componentwiseMWIS(kernel, [](const CSRGraph& G, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff){
+        return greedyMWIS(G, IS, IS_weight, cutoff);
+    }, mwis, mwis_value, kernel_cutoff);
     if(!found) {
-        found = quantumMWIS(local_graph, mwis, mwis_value, cutoff);
+        found = componentwiseMWIS(kernel, [](const CSRGraph& G, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff){
+            return quantumMWIS(G, IS, IS_weight, cutoff);
+        }, mwis, mwis_value, kernel_cutoff);
         rqaoa_found += found;
 //        cout << "RQAOA found an IS of weight: " << mwis_value << endl;
     }
     if(!found){
-        found = cplexMWIS(local_graph, mwis, mwis_value, cutoff);
+        found = componentwiseMWIS(kernel, [](const CSRGraph& G, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff){
+            Graph graph;
+            graph.init_from_csr(G);
+            return cplexMWIS(graph, IS, IS_weight, cutoff);
+        }, mwis, mwis_value, kernel_cutoff);
         exact_found += found;
 //        cout << "CPLEX found an IS of weight: " << mwis_value << endl;
     }
     if(found) {
-        mwis = local_graph.recover_all_merged_to(mwis);
+        mwis = local_graph.recover_all_merged_to(reducer.lift(mwis));
         if (is_independent_set(*initial_graph, mwis))
             add_MWIS_variable_to_SCIP(scip, mwis);
         else
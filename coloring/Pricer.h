@@ -8,6 +8,7 @@
 #ifdef QB_ENABLE_SCIP
     #include "scip/scip.h"
     #include "objscip/objpricer.h"
+    #include "ConstraintHandler.h"
 #endif
 
 #include "../mwis/mwis.h"
@@ -30,6 +31,11 @@ class Pricer : public scip::ObjPricer {
     bool branching_accounted; // Is true if we had prepared the correct local graph
     Graph local_graph; // Graph with merged and split vertices defined by branching constraints
 
+    // Branching constraints applied to local_graph in order, with the checkpoint taken before each of them
+    vector<pair<SameDiff, size_t>> applied_constraints;
+    bool weights_set; // Is true if dual weights were set after the last checkpoint
+    size_t weights_mark; // Checkpoint taken before setting the dual weights
+
     // Logging information
     int rqaoa_found; // how often qaoa manages to find an improving variable
     int exact_found; // how often the exact method finds an improving variable
@@ -37,7 +43,9 @@ class Pricer : public scip::ObjPricer {
 private:
     /** Modifies the local Pricer graph at each node of the Branch & Bound tree
      *
-     * Constructs a local graph with merged and split nodes from the samediff constraints
+     * Constructs a local graph with merged and split nodes from the samediff constraints.
+     * Constraints shared with the previously processed node are kept, the graph is rolled back to the first differing constraint
+     * and only the remaining constraints are applied.
      * *
      * @param conshdlr
      * @return
@@ -54,11 +62,13 @@ private:
 public:
 
     Pricer (SCIP* scip, const Graph* _initial_graph, const vector<SCIP_CONS*>& constraints) :
-            counter(0), rqaoa_found(0), exact_found(0),
-            initial_graph(_initial_graph),
+            ObjPricer(scip, PRICER_NAME, PRICER_DESC, PRICER_PRIORITY, PRICER_DELAY),
+            counter(0), initial_graph(_initial_graph),
             covering_constraints(constraints),
             conshdlr(SCIPfindConshdlr(scip, "SameDiff")),
-            ObjPricer(scip, PRICER_NAME, PRICER_DESC, PRICER_PRIORITY, PRICER_DELAY) {};
+            branching_accounted(false), local_graph(*_initial_graph),
+            weights_set(false), weights_mark(0),
+            rqaoa_found(0), exact_found(0) {};
 
     /** Initialize the Pricer after the problem was transformed
      *
@@ -40,7 +40,7 @@ vector<int> dsatur(const Graph* graph, int& n_colors)
         if(used_color > n_colors)
             n_colors = used_color;
 
-        auto neighbors = graph->get_neighbors(*node_to_color);
+        const auto& neighbors = graph->get_neighbors(*node_to_color);
         for(const auto & u : neighbors)
         {
             if(uncolored.count(u))
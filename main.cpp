@@ -1,5 +1,8 @@
 #include <iostream>
 #include "Graph.h"
+#include "CSRGraph.h"
+#include "GraphCache.h"
+#include "Settings.h"
 
 #include "mwis/mwis.h"
 
@@ -34,8 +37,15 @@ int main(int argc, char* argv[]) {
     string problem_name(argv[1]);
     string instance_file(argv[2]);
 
-    Graph graph;
-    graph.read_dimacs(instance_file);
+    //The instance is mapped from its binary cache when possible, the mutable graph is built only for the methods that need it
+    CSRGraph instance;
+    try {
+        instance = load_graph(instance_file, true);
+    }
+    catch (const exception& e) {
+        cerr << "Can't read the instance: " << e.what() << endl;
+        return 1;
+    }
 
     if(problem_name == "-MWIS")
     {
@@ -44,33 +54,65 @@ int main(int argc, char* argv[]) {
         return 1;
         }
         string method(argv[3]);
+        //The instance is reduced before the method runs unless "-noreduce" follows the method
+        bool reduce = true;
+        try {
+            for(int i = 4; i < argc; i++) {
+                if(string(argv[i]) == "-noreduce")
+                    reduce = false;
+                else
+                    parse_setting(argv[i]);
+            }
+            check_settings();
+        }
+        catch (const invalid_argument& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
         WTYPE weight = 0;
         WTYPE cutoff = INF;
         N_CONTAINER independent_set;
 
+        MWISSolver solver;
         if(method == "-greedy") {
-            greedyMWIS(graph, independent_set, weight, cutoff);
+            solver = [](const CSRGraph& G, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff){ return greedyMWIS(G, IS, IS_weight, cutoff); };
+        }
+        if(method == "-ils") {
+            solver = [](const CSRGraph& G, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff){ return ilsMWIS(G, IS, IS_weight, cutoff); };
         }
         if(method == "-quantum") {
-            quantumMWIS(graph, independent_set, weight, cutoff);
+            solver = [](const CSRGraph& G, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff){ return quantumMWIS(G, IS, IS_weight, cutoff); };
         }
         #ifdef QB_ENABLE_CPLEX
         if(method == "-cplex") {
-            cplexMWIS(graph, independent_set, weight, cutoff);
+            solver = [](const CSRGraph& G, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff){
+                Graph graph;
+                graph.init_from_csr(G);
+                return cplexMWIS(graph, IS, IS_weight, cutoff);
+            };
         }
         #endif
+
+        if(solver) {
+            if(reduce)
+                reducedMWIS(instance, solver, independent_set, weight, cutoff);
+            else
+                componentwiseMWIS(instance, solver, independent_set, weight, cutoff);
+        }
         /*
         if(method == "-sewell") {
             sewellMWIS(graph, independent_set, weight, cutoff);
         }*/
 
-        cout << "MWIS is independent: " <<  is_independent_set(graph, independent_set) << endl;
+        cout << "MWIS is independent: " <<  is_independent_set(instance, independent_set) << endl;
         print_mwis_result(method, weight, independent_set);
     }
     
     if(problem_name == "-COLORING")
     {
         #ifdef QB_ENABLE_SCIP
+        Graph graph;
+        graph.init_from_csr(instance);
         vector<int> colors(graph.get_node_number(), 0);
         coloringBNP(graph, colors);
 
@@ -0,0 +1,107 @@
+//
+// Created on 17/10/26.
+//
+
+#include "Components.h"
+#include "mwis.h"
+#include <algorithm>
+
+vector<vector<N_ID>> connected_components(const CSRGraph& G) {
+    vector<vector<N_ID>> components;
+    vector<char> visited(G.get_node_number(), 0);
+    for(const auto& root: G.get_active_nodes()) {
+        if(visited[root])
+            continue;
+        //Breadth-first search, the component vector is used as the queue
+        vector<N_ID> component = {root};
+        visited[root] = 1;
+        for(size_t i = 0; i < component.size(); i++)
+            for(const auto& v: G.get_neighbors(component[i]))
+                if(!visited[v]) {
+                    visited[v] = 1;
+                    component.push_back(v);
+                }
+        sort(component.begin(), component.end());
+        components.push_back(std::move(component));
+    }
+    return components;
+}
+
+CSRGraph induced_subgraph(const CSRGraph& G, const vector<N_ID>& nodes) {
+    int size = nodes.size();
+    vector<int> offsets(size + 1, 0);
+    vector<N_ID> adjacency;
+    vector<WTYPE> weights(size);
+    for(int i = 0; i < size; i++) {
+        //Neighbors are sorted and the renumbering preserves the order
+        for(const auto& v: G.get_neighbors(nodes[i])) {
+            auto it = lower_bound(nodes.begin(), nodes.end(), v);
+            if(it != nodes.end() && *it == v)
+                adjacency.push_back(it - nodes.begin());
+        }
+        offsets[i + 1] = adjacency.size();
+        weights[i] = G.get_node_weight(nodes[i]);
+    }
+    return CSRGraph(size, std::move(offsets), std::move(adjacency), std::move(weights), G.is_weighted());
+}
+
+bool componentwiseMWIS(const CSRGraph& G, const MWISSolver& solver, N_CONTAINER& best_mwis, WTYPE& best_mwis_value, const WTYPE& cutoff) {
+    auto components = connected_components(G);
+
+    //Single nodes and edges are solved directly
+    N_CONTAINER mwis;
+    WTYPE value = 0;
+    vector<int> hard_components;
+    for(int c = 0; c < (int) components.size(); c++) {
+        const auto& component = components[c];
+        if(component.size() > 2) {
+            hard_components.push_back(c);
+            continue;
+        }
+        N_ID u = *max_element(component.begin(), component.end(), [&G](auto a, auto b){ return G.get_node_weight(a) < G.get_node_weight(b); });
+        if(G.get_node_weight(u) > 0) {
+            mwis.insert(u);
+            value += G.get_node_weight(u);
+        }
+    }
+
+    //The largest components are solved first
+    sort(hard_components.begin(), hard_components.end(), [&components](int a, int b){ return components[a].size() > components[b].size(); });
+
+    //The heaviest node of a component is an independent set, it bounds from below the value of the components not solved yet
+    vector<N_ID> heaviest(hard_components.size());
+    WTYPE remaining = 0;
+    for(int i = 0; i < (int) hard_components.size(); i++) {
+        const auto& component = components[hard_components[i]];
+        heaviest[i] = *max_element(component.begin(), component.end(), [&G](auto a, auto b){ return G.get_node_weight(a) < G.get_node_weight(b); });
+        remaining += max<WTYPE>(0, G.get_node_weight(heaviest[i]));
+    }
+
+    //The components are solved one after another: the solvers are parallel themselves and RQAOA seeds the global NLopt generator.
+    //The cutoff of a component is what is missing to the cutoff with the values found so far and the bound of the other components,
+    //a component is not solved if its heaviest node is enough
+    for(int i = 0; i < (int) hard_components.size(); i++) {
+        const auto& component = components[hard_components[i]];
+        WTYPE heaviest_weight = max<WTYPE>(0, G.get_node_weight(heaviest[i]));
+        remaining -= heaviest_weight;
+        N_CONTAINER component_mwis;
+        WTYPE component_value = 0;
+        if(value + heaviest_weight + remaining <= cutoff)
+            solver(induced_subgraph(G, component), component_mwis, component_value, cutoff - value - remaining);
+        if(component_value < heaviest_weight) {
+            mwis.insert(heaviest[i]);
+            value += heaviest_weight;
+            continue;
+        }
+        for(const auto& u: component_mwis)
+            mwis.insert(component[u]);
+        value += component_value;
+    }
+
+    WTYPE mwis_value = G.get_nodeset_weight(mwis);
+    if(mwis_value > best_mwis_value) {
+        best_mwis = mwis;
+        best_mwis_value = mwis_value;
+    }
+    return best_mwis_value > cutoff;
+}
@@ -0,0 +1,25 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_COMPONENTS_H
+#define QUANTUM_BNP_COMPONENTS_H
+
+#include "../CSRGraph.h"
+
+/** Find the connected components formed by the active nodes
+ *
+ * @param G
+ * @return the nodes of each component in increasing order, components are ordered by their smallest node
+ */
+vector<vector<N_ID>> connected_components(const CSRGraph& G);
+
+/** Build the subgraph induced by a set of active nodes, the node nodes[i] becomes the node i
+ *
+ * @param G
+ * @param nodes sorted in increasing order
+ * @return
+ */
+CSRGraph induced_subgraph(const CSRGraph& G, const vector<N_ID>& nodes);
+
+#endif //QUANTUM_BNP_COMPONENTS_H
@@ -0,0 +1,70 @@
+//
+// Created on 17/10/26.
+//
+
+#include "ILS.h"
+#include "mwis.h"
+#include <chrono>
+
+WTYPE IteratedLocalSearch::run(N_CONTAINER& IS, double time_limit, const WTYPE& cutoff, const atomic<bool>* stop) {
+    auto start = chrono::steady_clock::now();
+    auto elapsed = [&start](){ return chrono::duration<double>(chrono::steady_clock::now() - start).count(); };
+
+    ls.reset(IS);
+    ls.descend();
+    WTYPE best_weight = ls.get_solution_weight();
+    IS = ls.get_solution();
+
+    //Differences of weights are measured in units of the largest weight
+    WTYPE scale = graph->get_max_weight() > 0 ? graph->get_max_weight() : 1;
+    uniform_real_distribution<double> uniform(0, 1);
+
+    while(best_weight <= cutoff && elapsed() < time_limit && !(stop && *stop) && ls.get_non_solution_number() > 0) {
+        WTYPE current_weight = ls.get_solution_weight();
+        ls.begin_changes();
+
+        //Perturbation
+        int k = 1;
+        if(uniform(generator) < ILS_MULTI_INSERTION_PROBABILITY)
+            k = 2 + generator() % (ILS_MAX_INSERTIONS - 1);
+        for(int i = 0; i < k && ls.get_non_solution_number() > 0; i++)
+            ls.force_insert(ls.get_non_solution_node(generator() % ls.get_non_solution_number()));
+
+        ls.descend();
+        ls.clear_tabu();
+        ls.descend();
+
+        WTYPE weight = ls.get_solution_weight();
+        if(weight > best_weight) {
+            best_weight = weight;
+            IS = ls.get_solution();
+        }
+        else if(weight < current_weight) {
+            double delta = (current_weight - weight) / scale;
+            double best_delta = (best_weight - weight) / scale;
+            if(uniform(generator) >= 1 / (1 + delta * best_delta))
+                ls.undo_changes();
+        }
+    }
+    return best_weight;
+}
+
+bool ilsMWIS(const CSRGraph& graph, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff) {
+    if(greedyMWIS(graph, IS, IS_weight, cutoff))
+        return true;
+    return improve_with_ils(graph, IS, IS_weight, cutoff, settings().ils_time);
+}
+
+bool improve_with_ils(const CSRGraph& graph, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff, double time_limit) {
+    if(time_limit <= 0 || graph.get_active_nodes().empty())
+        return IS_weight > cutoff;
+
+    IteratedLocalSearch ils(&graph, settings().seed);
+    N_CONTAINER improved_IS = IS;
+    WTYPE improved_weight = ils.run(improved_IS, time_limit, cutoff);
+    if(improved_weight > IS_weight) {
+        IS = improved_IS;
+        IS_weight = improved_weight;
+    }
+    return IS_weight > cutoff;
+}
@@ -0,0 +1,44 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_ILS_H
+#define QUANTUM_BNP_ILS_H
+
+#include <random>
+#include <atomic>
+#include "LocalSearch.h"
+
+//Probability that a perturbation inserts more than one node
+#define ILS_MULTI_INSERTION_PROBABILITY 0.1
+
+//Maximal number of nodes inserted by one perturbation
+#define ILS_MAX_INSERTIONS 4
+
+/** Iterated local search for the weighted independent set problem
+ *
+ * The algorithm of [Fast Local Search for the Maximum Independent Set Problem] by D. Andrade, M. G. C. Resende and R. F. F. Werneck:
+ * each iteration forces one (rarely several) random nodes into the solution, removes their neighbors and forbids them to come back (tabu)
+ * while the local search with (1,2)-swaps descends to a new local optimum. A worse local optimum is kept with a probability
+ * that decreases with its distance to the current and to the best solution, otherwise the perturbation is undone.
+ */
+class IteratedLocalSearch {
+    const CSRGraph* graph;
+    LocalSearch ls;
+    mt19937 generator;
+
+public:
+    IteratedLocalSearch(const CSRGraph* g, unsigned seed) : graph(g), ls(g), generator(seed) {};
+
+    /** Improve the independent set until the time is over or the weight exceeds the cutoff
+     *
+     * @param IS in input the initial independent set, in output the best found independent set
+     * @param time_limit in seconds
+     * @param cutoff
+     * @param stop if not null, the search ends when it becomes true
+     * @return the weight of IS
+     */
+    WTYPE run(N_CONTAINER& IS, double time_limit, const WTYPE& cutoff = INF, const atomic<bool>* stop = nullptr);
+};
+
+#endif //QUANTUM_BNP_ILS_H
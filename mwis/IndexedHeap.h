@@ -0,0 +1,123 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_INDEXEDHEAP_H
+#define QUANTUM_BNP_INDEXEDHEAP_H
+
+#include <vector>
+#include "../Graph.h"
+
+/** A binary max-heap of nodes with priorities that can be changed
+ *
+ * Nodes are identified by their index in [0, size), priorities are stored in a dense array.
+ * The top is the node of the highest priority, the smallest node among equal priorities.
+ * Insertion, removal and priority changes cost O(log size).
+ */
+class IndexedHeap {
+    vector<N_ID> heap;
+    vector<int> position; // position of each node in the heap, -1 if it isn't in the heap
+    vector<WTYPE> priority;
+
+    bool before(const N_ID& a, const N_ID& b) const { return priority[a] > priority[b] || (priority[a] == priority[b] && a < b); };
+
+    void place(int i, const N_ID& u) { heap[i] = u; position[u] = i; };
+
+    void sift_up(int i) {
+        N_ID u = heap[i];
+        while(i > 0 && before(u, heap[(i - 1) / 2])) {
+            place(i, heap[(i - 1) / 2]);
+            i = (i - 1) / 2;
+        }
+        place(i, u);
+    }
+
+    void sift_down(int i) {
+        N_ID u = heap[i];
+        int size = heap.size();
+        while(2 * i + 1 < size) {
+            int child = 2 * i + 1;
+            if(child + 1 < size && before(heap[child + 1], heap[child]))
+                child++;
+            if(!before(heap[child], u))
+                break;
+            place(i, heap[child]);
+            i = child;
+        }
+        place(i, u);
+    }
+
+public:
+    explicit IndexedHeap(int size) : position(size, -1), priority(size, 0) {};
+
+    /** Remove all nodes and set the number of nodes, the memory is reused
+     *
+     */
+    void reset(int size) {
+        heap.clear();
+        position.assign(size, -1);
+        priority.assign(size, 0);
+    }
+
+    bool empty() const { return heap.empty(); };
+    int size() const { return heap.size(); };
+    bool contains(const N_ID& u) const { return position[u] != -1; };
+    N_ID top() const { return heap[0]; };
+    WTYPE get_priority(const N_ID& u) const { return priority[u]; };
+
+    /** Insert a node that isn't in the heap
+     *
+     */
+    void push(const N_ID& u, const WTYPE& p) {
+        priority[u] = p;
+        heap.push_back(u);
+        sift_up(heap.size() - 1);
+    }
+
+    /** Remove the node if it is in the heap
+     *
+     */
+    void erase(const N_ID& u) {
+        int i = position[u];
+        if(i == -1)
+            return;
+        position[u] = -1;
+        N_ID last = heap.back();
+        heap.pop_back();
+        if(last == u)
+            return;
+        place(i, last);
+        sift_up(i);
+        sift_down(position[last]);
+    }
+
+    N_ID pop() {
+        N_ID u = heap[0];
+        erase(u);
+        return u;
+    }
+
+    /** Change the priority of a node in the heap
+     *
+     */
+    void update(const N_ID& u, const WTYPE& p) {
+        bool increased = p > priority[u];
+        priority[u] = p;
+        if(increased)
+            sift_up(position[u]);
+        else
+            sift_down(position[u]);
+    }
+
+    /** Insert the node or change its priority
+     *
+     */
+    void push_or_update(const N_ID& u, const WTYPE& p) {
+        if(contains(u))
+            update(u, p);
+        else
+            push(u, p);
+    }
+};
+
+#endif //QUANTUM_BNP_INDEXEDHEAP_H
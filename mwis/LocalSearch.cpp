@@ -4,105 +4,273 @@
 
 #include "LocalSearch.h"
 #include <algorithm>
+#include <stdexcept>
 
-#include "../Graph.h"
+#include "../CSRGraph.h"
 
-void LocalSearch::init(N_CONTAINER& IS) {
-    active_nodes = IS;
-    deactivated_nodes = {};
-    tightness = vector<int>(graph->get_node_number(), 0);
-    for(const auto& u: active_nodes)
-        for(const auto& v: graph->get_neighbors(u))
+void LocalSearch::move(const N_ID &u, Block to) {
+    int from = block[u];
+    //Move the node across block boundaries, one block at a time
+    while(from < to) {
+        int last = block_start[from + 1] - 1;
+        N_ID other = permutation[last];
+        swap(permutation[position[u]], permutation[last]);
+        position[other] = position[u];
+        position[u] = last;
+        block_start[from + 1]--;
+        from++;
+    }
+    while(from > to) {
+        int first = block_start[from];
+        N_ID other = permutation[first];
+        swap(permutation[position[u]], permutation[first]);
+        position[other] = position[u];
+        position[u] = first;
+        block_start[from]++;
+        from--;
+    }
+    block[u] = to;
+}
+
+void LocalSearch::init(const N_CONTAINER& IS) {
+    int n = graph->get_node_number();
+    tightness.assign(n, 0);
+    solution_neighbor_sum.assign(n, 0);
+    solution_neighbor_weight.assign(n, 0);
+    position.assign(n, -1);
+    block.assign(n, N_BLOCKS);
+    best_pair.assign(n, {-1, -1});
+    pair_gains.reset(n);
+    insertion_gains.reset(n);
+    tabu_nodes.clear();
+    tabu_tightness = n + 1;
+    recording = false;
+    solution_weight = 0;
+    for(const auto& u: IS) {
+        solution_weight += graph->get_node_weight(u);
+        for(const auto& v: graph->get_neighbors(u)) {
             tightness[v]++;
-    for(const auto& u: graph->get_active_nodes())
-        if(!active_nodes.count(u) && tightness[u] == 0)
-            free_nodes.insert(u);
+            solution_neighbor_sum[v] += u;
+            solution_neighbor_weight[v] += graph->get_node_weight(u);
+        }
+    }
+
+    //Counting sort of the active nodes by block
+    const auto& nodes = graph->get_active_nodes();
+    int count[N_BLOCKS] = {};
+    for(const auto& u: nodes) {
+        block[u] = IS.count(u) ? BLOCK_ACTIVE : (tightness[u] == 0 ? BLOCK_FREE : BLOCK_NON_FREE);
+        count[block[u]]++;
+        if(!IS.count(u))
+            insertion_gains.push(u, graph->get_node_weight(u) - solution_neighbor_weight[u]);
+    }
+    block_start[0] = 0;
+    for(int b = 0; b < N_BLOCKS; b++)
+        block_start[b + 1] = block_start[b] + count[b];
+    int fill[N_BLOCKS];
+    copy(block_start, block_start + N_BLOCKS, fill);
+    permutation.resize(nodes.size());
+    for(const auto& u: nodes) {
+        position[u] = fill[block[u]]++;
+        permutation[position[u]] = u;
+    }
     to_maximal();
 }
 
-bool LocalSearch::find_swap(N_ID &exit, N_ID & enter1, N_ID & enter2) {
-    auto it = active_nodes.begin();
-    while (it != active_nodes.end()) {
-        vector<N_ID> one_tight_neighbors{};
-        N_ID u = *it;
-        for (const auto &v: graph->get_neighbors(u))
-            if (tightness[v] == 1)
-                one_tight_neighbors.push_back(v);
-
-        for (auto v = one_tight_neighbors.begin(); v != one_tight_neighbors.end(); v++) {
-            auto neighbors = graph->get_neighbors(*v);
-            auto w = v + 1;
-            auto v_neighbor = neighbors.begin();
-            while (w != one_tight_neighbors.end() && v_neighbor != neighbors.end()) {
-                if (graph->get_node_weight(*w) + graph->get_node_weight(*v) >= graph->get_node_weight(u)) {
-                    if (*w < *v_neighbor) break;
-                    else if (*w == *v_neighbor)  w++;
-                    v_neighbor++;
-                }
-                else w++;
-            }
-            if (w != one_tight_neighbors.end()) {
-                exit = u; enter1 = *v; enter2 = *w;
-                return true;
+void LocalSearch::invalidate_pair_gain(const N_ID &u) {
+    if(block[u] == BLOCK_DONE) {
+        pair_gains.erase(u);
+        move(u, BLOCK_ACTIVE);
+    }
+}
+
+void LocalSearch::update_pair_gain(const N_ID &u) {
+    //Neighbors of u whose only solution neighbor is u, the heaviest first
+    one_tight_neighbors.clear();
+    for (const auto &v: graph->get_neighbors(u))
+        if (tightness[v] == 1)
+            one_tight_neighbors.push_back(v);
+    sort(one_tight_neighbors.begin(), one_tight_neighbors.end(), [this](auto a, auto b){
+        return graph->get_node_weight(a) > graph->get_node_weight(b);
+    });
+
+    //The scan of each v stops at the first non-adjacent partner, the later ones are lighter
+    WTYPE best = -INF;
+    int size = one_tight_neighbors.size();
+    for (int i = 0; i + 1 < size; i++) {
+        N_ID v = one_tight_neighbors[i];
+        if (graph->get_node_weight(v) + graph->get_node_weight(one_tight_neighbors[i + 1]) <= best)
+            break;
+        for (int j = i + 1; j < size; j++) {
+            N_ID w = one_tight_neighbors[j];
+            if (graph->get_node_weight(v) + graph->get_node_weight(w) <= best)
+                break;
+            if (!graph->has_edge(v, w)) {
+                best = graph->get_node_weight(v) + graph->get_node_weight(w);
+                best_pair[u] = {v, w};
+                break;
             }
         }
-        it = active_nodes.erase(it);
-        deactivated_nodes.insert(u);
     }
-    return false;
+
+    move(u, BLOCK_DONE);
+    if (best > -INF)
+        pair_gains.push(u, best - graph->get_node_weight(u));
+}
+
+void LocalSearch::add_solution_neighbor_weight(const N_ID &v, const WTYPE &weight) {
+    solution_neighbor_weight[v] += weight;
+    if(insertion_gains.contains(v))
+        insertion_gains.update(v, graph->get_node_weight(v) - solution_neighbor_weight[v]);
 }
 
 void LocalSearch::remove_from_solution(const N_ID &u) {
-    if(!active_nodes.count(u))
+    if(!in_solution(u))
         throw std::range_error("Can't remove vertex that is not in solution");
+    pair_gains.erase(u);
+    move(u, BLOCK_FREE);
+    insertion_gains.push(u, graph->get_node_weight(u) - solution_neighbor_weight[u]);
+    solution_weight -= graph->get_node_weight(u);
+    if(recording)
+        changes.push_back({u, false});
     for(const auto& v: graph->get_neighbors(u)) {
         tightness[v]--;
+        solution_neighbor_sum[v] -= u;
+        add_solution_neighbor_weight(v, -graph->get_node_weight(u));
         if(tightness[v] == 0)
-            free_nodes.insert(v);
+            move(v, BLOCK_FREE);
         if(tightness[v] == 1)
-        {
-            auto it = find_if(deactivated_nodes.begin(), deactivated_nodes.end(), [this, v](const N_ID& u){return graph->has_edge(u, v);});
-            if(it != deactivated_nodes.end())
-            {
-                active_nodes.insert(*it);
-                deactivated_nodes.erase(it);
-            }
-        }
+            //The unique solution neighbor of v may have a new swap
+            invalidate_pair_gain(solution_neighbor_sum[v]);
     }
-    active_nodes.erase(u);
 }
 
 void LocalSearch::add_to_solution(const N_ID &u) {
-    if(!free_nodes.count(u))
+    if(block[u] != BLOCK_FREE)
         throw std::range_error("Can't add vertex that is not free");
+    insertion_gains.erase(u);
+    move(u, BLOCK_ACTIVE);
+    solution_weight += graph->get_node_weight(u);
+    if(recording)
+        changes.push_back({u, true});
     for(const auto& v: graph->get_neighbors(u)) {
+        //v is no longer 1-tight, the swaps of its solution neighbor lose it
+        if(tightness[v] == 1)
+            invalidate_pair_gain(solution_neighbor_sum[v]);
         tightness[v]++;
-        free_nodes.erase(v);
+        solution_neighbor_sum[v] += u;
+        add_solution_neighbor_weight(v, graph->get_node_weight(u));
+        if(block[v] == BLOCK_FREE)
+            move(v, BLOCK_NON_FREE);
     }
-    free_nodes.erase(u);
-    active_nodes.insert(u);
 }
 
 
 void LocalSearch::to_maximal() {
-    while(!free_nodes.empty())
+    while(!block_empty(BLOCK_FREE))
+        add_to_solution(block_front(BLOCK_FREE));
+}
+
+void LocalSearch::descend() {
+    while (true)
     {
-        auto it = free_nodes.begin();
-        N_ID u = *it;
-        add_to_solution(u);
+        to_maximal();
+        while (!block_empty(BLOCK_ACTIVE))
+            update_pair_gain(block_front(BLOCK_ACTIVE));
+
+        WTYPE insertion_gain = insertion_gains.empty() ? -INF : insertion_gains.get_priority(insertion_gains.top());
+        WTYPE pair_gain = pair_gains.empty() ? -INF : pair_gains.get_priority(pair_gains.top());
+
+        if (insertion_gain > EPSILON && insertion_gain >= pair_gain) {
+            //(ω,1)-swap
+            N_ID v = insertion_gains.top();
+            vector<N_ID> leaving;
+            WTYPE leaving_weight = 0;
+            for (const auto& u: graph->get_neighbors(v))
+                if (in_solution(u)) {
+                    leaving.push_back(u);
+                    leaving_weight += graph->get_node_weight(u);
+                }
+            //The cached gain accumulates rounding errors with fractional weights, a swap on a rounding gain could undo a
+            //zero-gain (1,2)-swap forever. The gain is reset to its exact value and the swap is applied only if it is still positive
+            WTYPE exact_gain = graph->get_node_weight(v) - leaving_weight;
+            if (exact_gain <= EPSILON) {
+                solution_neighbor_weight[v] = leaving_weight;
+                insertion_gains.update(v, exact_gain);
+                continue;
+            }
+            for (const auto& u: leaving)
+                remove_from_solution(u);
+            add_to_solution(v);
+        }
+        else if (pair_gain >= -EPSILON) {
+            //(1,2)-swap, a swap without gain is still accepted since it adds a node to the solution
+            N_ID u = pair_gains.top();
+            auto [v, w] = best_pair[u];
+            remove_from_solution(u);
+            add_to_solution(v);
+            add_to_solution(w);
+        }
+        else
+            break;
     }
 }
 
 void LocalSearch::improve(N_CONTAINER &IS) {
     init(IS);
-    N_ID exit, enter1, enter2;
-    while (find_swap(exit, enter1, enter2))
-    {
-        remove_from_solution(exit);
-        add_to_solution(enter1);
-        add_to_solution(enter2);
-        to_maximal();
-    }
-    IS = deactivated_nodes;
+    descend();
+    IS = get_solution();
     return;
-}
\ No newline at end of file
+}
+
+void LocalSearch::force_insert(const N_ID &u) {
+    if(in_solution(u))
+        return;
+    //Solution neighbors of u, they are not all found by the tightness if u is tabu
+    vector<N_ID> removed;
+    for(const auto& v: graph->get_neighbors(u))
+        if(in_solution(v))
+            removed.push_back(v);
+    for(const auto& v: removed)
+        remove_from_solution(v);
+    if(block[u] == BLOCK_NON_FREE) {
+        //u is tabu only if it was removed by a previous insertion of the same perturbation
+        tightness[u] -= tabu_tightness;
+        tabu_nodes.erase(find(tabu_nodes.begin(), tabu_nodes.end(), u));
+        move(u, BLOCK_FREE);
+        insertion_gains.push(u, graph->get_node_weight(u) - solution_neighbor_weight[u]);
+    }
+    add_to_solution(u);
+    for(const auto& v: removed) {
+        if(tightness[v] == 1)
+            invalidate_pair_gain(solution_neighbor_sum[v]);
+        tightness[v] += tabu_tightness;
+        if(block[v] == BLOCK_FREE)
+            move(v, BLOCK_NON_FREE);
+        insertion_gains.erase(v);
+        tabu_nodes.push_back(v);
+    }
+}
+
+void LocalSearch::clear_tabu() {
+    for(const auto& v: tabu_nodes) {
+        tightness[v] -= tabu_tightness;
+        insertion_gains.push(v, graph->get_node_weight(v) - solution_neighbor_weight[v]);
+        if(tightness[v] == 0)
+            move(v, BLOCK_FREE);
+        else if(tightness[v] == 1)
+            invalidate_pair_gain(solution_neighbor_sum[v]);
+    }
+    tabu_nodes.clear();
+}
+
+void LocalSearch::undo_changes() {
+    recording = false;
+    for(auto it = changes.rbegin(); it != changes.rend(); it++) {
+        if(it->second)
+            remove_from_solution(it->first);
+        else
+            add_to_solution(it->first);
+    }
+    changes.clear();
+}
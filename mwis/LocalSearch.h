@@ -4,39 +4,91 @@
 
 #ifndef QUANTUM_BNP_LOCALSEARCH_H
 #define QUANTUM_BNP_LOCALSEARCH_H
-#include "../Graph.h"
+#include "../CSRGraph.h"
+#include "IndexedHeap.h"
 
 /**
  * This class allows to improve a solution for the independent set problem by performing local modifications.
  * It implements the algorithm introduced in the paper [Fast Local Search for the Maximum Independent Set Problem] by D. Andrade, M. G. C. Resende and R. F. F. Werneck
+ * with two weighted neighborhoods:
+ * - (1,2)-swaps: a solution node u leaves and two non-adjacent nodes whose only solution neighbor is u enter,
+ * - (ω,1)-swaps: a node enters and its solution neighbors leave.
+ * The gains of both moves are cached in priority queues and refreshed only around nodes whose tightness changed, the best move is applied first.
  */
 class LocalSearch {
-    const Graph* graph;
-    vector<int> tightness;
-    N_CONTAINER active_nodes;
-    N_CONTAINER free_nodes;
-    N_CONTAINER deactivated_nodes;
+    const CSRGraph* graph;
 
+    /** Blocks of the partitioned permutation of the active nodes of the graph
+     *
+     * Solution nodes are either active (their best (1,2)-swap must be recomputed) or done. Non-solution nodes are free if they
+     * have no neighbor in the solution.
+     */
+    enum Block {BLOCK_DONE, BLOCK_ACTIVE, BLOCK_FREE, BLOCK_NON_FREE, N_BLOCKS};
+
+    vector<N_ID> permutation; // nodes grouped by block
+    vector<int> position; // position of each node in the permutation
+    vector<Block> block; // block of each node
+    int block_start[N_BLOCKS + 1]; // the block b occupies permutation[block_start[b]] ... permutation[block_start[b+1] - 1]
+
+    vector<int> tightness; // number of solution neighbors of each node, tabu nodes get an additional tabu_tightness
+    vector<long long> solution_neighbor_sum; // sum of the solution neighbors of each node, it is the unique one for 1-tight nodes
+    vector<WTYPE> solution_neighbor_weight; // weight of the solution neighbors of each node
+    WTYPE solution_weight;
+
+    IndexedHeap pair_gains; // done solution nodes with a (1,2)-swap, by the gain of their best swap
+    vector<pair<N_ID, N_ID>> best_pair; // the nodes entering in the best (1,2)-swap of each done solution node
+    IndexedHeap insertion_gains; // non-tabu nodes outside of the solution, by the gain of their (ω,1)-swap
+    vector<N_ID> one_tight_neighbors; // buffer of update_pair_gain
+
+    // Tabu nodes are never free nor 1-tight, so they can't enter the solution
+    vector<N_ID> tabu_nodes;
+    int tabu_tightness;
+
+    // Nodes added (true) and removed (false) since begin_changes, in order
+    vector<pair<N_ID, bool>> changes;
+    bool recording;
+
+    /** Move the node to another block
+     *
+     * @note costs O(N_BLOCKS)
+     */
+    void move(const N_ID& u, Block to);
+
+    bool block_empty(Block b) const { return block_start[b] == block_start[b + 1]; };
+    N_ID block_front(Block b) const { return permutation[block_start[b]]; };
 
     /** Initialize the data structures required for a local search
      *
-     * @param g
+     * @param IS
+     */
+    void init(const N_CONTAINER& IS);
+
+    /** The set of 1-tight neighbors of the solution node changed, its best (1,2)-swap must be recomputed
+     *
+     */
+    void invalidate_pair_gain(const N_ID& u);
+
+    /** Compute the best (1,2)-swap of an active solution node and mark it as done
+     *
+     */
+    void update_pair_gain(const N_ID& u);
+
+    /** Change the weight of the solution neighbors of a node outside of the solution
+     *
      */
-    void init(N_CONTAINER& IS);
+    void add_solution_neighbor_weight(const N_ID& v, const WTYPE& weight);
 
-    /** Find if there exists a 1-to-2 swap that improves the solution value
+    /** Remove the node from the solution
      *
-     * @param exit stores the id of the node that should leave the solution
-     * @param enter1, enter2 store the id of the node that should enter the solution
-     * @return True if the method found an improving swap
+     * @param u
+     * @throw range_error if the node is not in the solution
      */
-    bool find_swap(N_ID& exit, N_ID & enter1, N_ID & enter2);
     void remove_from_solution(const N_ID& u);
 
     /** Add the free node to the solution
      *
      * @param u
-     * @throw  TODO
+     * @throw range_error if the node is not free
      */
     void add_to_solution(const N_ID& u);
 
@@ -48,13 +100,62 @@ class LocalSearch {
 
 public:
 
-    LocalSearch(const Graph *g) : graph(g) {};
+    LocalSearch(const CSRGraph *g) : graph(g), solution_weight(0), pair_gains(0), insertion_gains(0), tabu_tightness(0), recording(false) {};
 
     /** Performs a local search from a better independent set around the initial point
+     *
+     * The buffers are kept between calls, each call costs O(n + m) plus O(degrees of the touched nodes) per swap
      *
      * @param IS the initial solution obtained with a constructive heuristic
      */
     void improve(N_CONTAINER& IS);
+
+    /** Primitives of perturbation-based searches (see IteratedLocalSearch)
+     *
+     */
+
+    /** Replace the stored solution by the maximal extension of IS
+     *
+     */
+    void reset(const N_CONTAINER& IS) { init(IS); };
+
+    /** Apply the best swap until no swap improves the weight
+     *
+     * (1,2)-swaps that keep the weight are applied as well, as they increase the size of the solution
+     */
+    void descend();
+
+    WTYPE get_solution_weight() const { return solution_weight; };
+    N_CONTAINER get_solution() const { return N_CONTAINER(permutation.begin(), permutation.begin() + block_start[BLOCK_FREE]); };
+
+    /** Nodes outside of the solution are numbered from 0 to get_non_solution_number() - 1
+     *
+     */
+    int get_non_solution_number() const { return block_start[N_BLOCKS] - block_start[BLOCK_FREE]; };
+    N_ID get_non_solution_node(int i) const { return permutation[block_start[BLOCK_FREE] + i]; };
+    bool in_solution(const N_ID& u) const { return block[u] == BLOCK_DONE || block[u] == BLOCK_ACTIVE; };
+
+    /** Add a node outside of the solution and remove its neighbors from the solution, the removed nodes become tabu
+     *
+     * @param u
+     */
+    void force_insert(const N_ID& u);
+
+    /** Allow tabu nodes to enter the solution again
+     *
+     */
+    void clear_tabu();
+
+    /** Start recording the modifications of the solution
+     *
+     */
+    void begin_changes() { changes.clear(); recording = true; };
+
+    /** Restore the solution stored when begin_changes was called
+     *
+     * @note must be called when there are no tabu nodes
+     */
+    void undo_changes();
 };
 
 
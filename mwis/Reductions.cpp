@@ -0,0 +1,249 @@
+//
+// Created on 17/10/26.
+//
+
+#include "Reductions.h"
+#include "mwis.h"
+#include <algorithm>
+
+MWISReducer::MWISReducer(const CSRGraph& G):
+        node_number(G.get_node_number()), adj(G.get_node_number()), weights(G.get_node_number(), 0),
+        alive(G.get_node_number(), 0), offset(0), in_queue(G.get_node_number(), 0) {
+    for(const auto& u: G.get_active_nodes()) {
+        alive[u] = 1;
+        weights[u] = G.get_node_weight(u);
+        auto neighbors = G.get_neighbors(u);
+        adj[u] = N_CONTAINER(neighbors.begin(), neighbors.end());
+    }
+}
+
+void MWISReducer::push(const N_ID& u) {
+    if(alive[u] && !in_queue[u]) {
+        in_queue[u] = 1;
+        queue.push_back(u);
+    }
+}
+
+void MWISReducer::remove_node(N_ID u) {
+    alive[u] = 0;
+    for(const auto& x: adj[u]) {
+        adj[x].erase(u);
+        push(x);
+    }
+    adj[u].clear();
+}
+
+void MWISReducer::include_node(N_ID v) {
+    trace.push_back({REDUCTION_INCLUDE, v, -1, -1});
+    offset += weights[v];
+    vector<N_ID> neighbors(adj[v].begin(), adj[v].end());
+    for(const auto& u: neighbors)
+        remove_node(u);
+    remove_node(v);
+}
+
+bool MWISReducer::is_simplicial(const N_ID& v) const {
+    for(const auto& a: adj[v])
+        for(const auto& b: adj[v])
+            if(a < b && !adj[a].count(b))
+                return false;
+    return true;
+}
+
+bool MWISReducer::reduce_domination(const N_ID& v) {
+    if(adj[v].size() > REDUCTION_MAX_DEGREE)
+        return false;
+    for(N_ID u: adj[v]) {
+        if(weights[u] > weights[v] || adj[u].size() < adj[v].size())
+            continue;
+        //N[v] ⊆ N[u], so any solution containing u can take v instead
+        bool dominated = true;
+        for(const auto& x: adj[v])
+            if(x != u && !adj[u].count(x)) {
+                dominated = false;
+                break;
+            }
+        if(dominated) {
+            remove_node(u);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MWISReducer::reduce_twin(const N_ID& v) {
+    if(adj[v].empty() || adj[v].size() > REDUCTION_MAX_DEGREE)
+        return false;
+    //Twins of v are neighbors of each of its neighbors, scan the smallest neighborhood
+    N_ID x = *min_element(adj[v].begin(), adj[v].end(), [this](auto a, auto b){ return adj[a].size() < adj[b].size(); });
+    if(adj[x].size() > REDUCTION_MAX_DEGREE)
+        return false;
+    for(N_ID u: adj[x]) {
+        if(u != v && weights[u] > 0 && adj[u].size() == adj[v].size() && adj[u] == adj[v]) {
+            trace.push_back({REDUCTION_TWIN, v, u, -1});
+            weights[v] += weights[u];
+            remove_node(u);
+            for(const auto& y: adj[v])
+                push(y);
+            push(v);
+            return true;
+        }
+    }
+    return false;
+}
+
+void MWISReducer::fold_degree_two(const N_ID& v, const N_ID& a, const N_ID& b) {
+    trace.push_back({REDUCTION_FOLD2, v, a, b});
+    offset += weights[v];
+    weights[v] = weights[a] + weights[b] - weights[v];
+
+    N_CONTAINER neighbors = adj[a];
+    neighbors.insert(adj[b].begin(), adj[b].end());
+    neighbors.erase(v);
+    remove_node(a);
+    remove_node(b);
+
+    adj[v] = neighbors;
+    for(const auto& x: neighbors) {
+        adj[x].insert(v);
+        push(x);
+    }
+    push(v);
+}
+
+bool MWISReducer::reduce_node(const N_ID& v) {
+    if(!alive[v])
+        return false;
+
+    if(weights[v] <= 0) {
+        remove_node(v);
+        return true;
+    }
+
+    //Neighbors of non-positive weight are never needed in a solution
+    WTYPE neighborhood_weight = 0;
+    WTYPE max_neighbor_weight = 0;
+    for(const auto& u: adj[v]) {
+        neighborhood_weight += max<WTYPE>(weights[u], 0);
+        max_neighbor_weight = max(max_neighbor_weight, weights[u]);
+    }
+    if(weights[v] >= neighborhood_weight) {
+        include_node(v);
+        return true;
+    }
+
+    //Here w(v) < w(N(v))
+    if(adj[v].size() == 1) {
+        N_ID u = *adj[v].begin();
+        trace.push_back({REDUCTION_FOLD1, v, u, -1});
+        offset += weights[v];
+        weights[u] -= weights[v];
+        remove_node(v);
+        for(const auto& x: adj[u])
+            push(x);
+        return true;
+    }
+    if(adj[v].size() == 2) {
+        N_ID a = *adj[v].begin();
+        N_ID b = *adj[v].rbegin();
+        if(!adj[a].count(b) && weights[v] >= max_neighbor_weight) {
+            fold_degree_two(v, a, b);
+            return true;
+        }
+    }
+    if(adj[v].size() <= REDUCTION_MAX_DEGREE && weights[v] >= max_neighbor_weight && is_simplicial(v)) {
+        include_node(v);
+        return true;
+    }
+    return reduce_domination(v) || reduce_twin(v);
+}
+
+void MWISReducer::reduce() {
+    for(int u = node_number - 1; u >= 0; u--)
+        push(u);
+    while(!queue.empty()) {
+        N_ID v = queue.back();
+        queue.pop_back();
+        in_queue[v] = 0;
+        if(reduce_node(v))
+            push(v);
+    }
+}
+
+CSRGraph MWISReducer::get_kernel() {
+    kernel_nodes.clear();
+    vector<N_ID> kernel_id(node_number, -1);
+    for(int u = 0; u < node_number; u++)
+        if(alive[u]) {
+            kernel_id[u] = kernel_nodes.size();
+            kernel_nodes.push_back(u);
+        }
+
+    int size = kernel_nodes.size();
+    vector<int> offsets(size + 1, 0);
+    vector<N_ID> adjacency;
+    vector<WTYPE> kernel_weights(size);
+    for(int i = 0; i < size; i++) {
+        //The renumbering preserves the order, so the rows stay sorted
+        for(const auto& x: adj[kernel_nodes[i]])
+            adjacency.push_back(kernel_id[x]);
+        offsets[i + 1] = adjacency.size();
+        kernel_weights[i] = weights[kernel_nodes[i]];
+    }
+    return CSRGraph(size, std::move(offsets), std::move(adjacency), std::move(kernel_weights), true);
+}
+
+N_CONTAINER MWISReducer::lift(const N_CONTAINER& kernel_solution) const {
+    vector<char> in_solution(node_number, 0);
+    for(const auto& i: kernel_solution)
+        in_solution[kernel_nodes[i]] = 1;
+
+    for(auto it = trace.rbegin(); it != trace.rend(); it++) {
+        switch (it->type) {
+            case REDUCTION_INCLUDE:
+                in_solution[it->v] = 1;
+                break;
+            case REDUCTION_FOLD1:
+                if(!in_solution[it->a])
+                    in_solution[it->v] = 1;
+                break;
+            case REDUCTION_FOLD2:
+                if(in_solution[it->v]) {
+                    in_solution[it->v] = 0;
+                    in_solution[it->a] = 1;
+                    in_solution[it->b] = 1;
+                }
+                else
+                    in_solution[it->v] = 1;
+                break;
+            case REDUCTION_TWIN:
+                if(in_solution[it->v])
+                    in_solution[it->a] = 1;
+                break;
+        }
+    }
+
+    N_CONTAINER res;
+    for(int u = 0; u < node_number; u++)
+        if(in_solution[u])
+            res.insert(u);
+    return res;
+}
+
+bool reducedMWIS(const CSRGraph& G, const MWISSolver& solver, N_CONTAINER& best_mwis, WTYPE& best_mwis_value, const WTYPE& cutoff) {
+    MWISReducer reducer(G);
+    reducer.reduce();
+    CSRGraph kernel = reducer.get_kernel();
+
+    N_CONTAINER kernel_mwis;
+    WTYPE kernel_value = 0;
+    componentwiseMWIS(kernel, solver, kernel_mwis, kernel_value, cutoff - reducer.get_offset());
+
+    N_CONTAINER mwis = reducer.lift(kernel_mwis);
+    WTYPE mwis_value = G.get_nodeset_weight(mwis);
+    if(mwis_value > best_mwis_value) {
+        best_mwis = mwis;
+        best_mwis_value = mwis_value;
+    }
+    return best_mwis_value > cutoff;
+}
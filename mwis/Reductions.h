@@ -0,0 +1,108 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_REDUCTIONS_H
+#define QUANTUM_BNP_REDUCTIONS_H
+
+#include <algorithm>
+#include "../CSRGraph.h"
+
+//Simplicial, domination and twin reductions are checked only for nodes of degree at most REDUCTION_MAX_DEGREE
+#define REDUCTION_MAX_DEGREE 64
+
+/** Shrinks an MWIS instance with exact reductions and lifts solutions of the reduced instance back
+ *
+ * The reductions (see [Exactly Solving the Maximum Weight Independent Set Problem on Large Real-World Graphs]):
+ * - nodes of non-positive weight are removed,
+ * - a node heavier than its neighborhood, or a simplicial node heavier than each of its neighbors, is taken,
+ * - a neighbor u of v with N[v] ⊆ N[u] and w(u) <= w(v) is removed (domination),
+ * - a node of degree 1 lighter than its neighbor is folded into the neighbor,
+ * - a node v of degree 2 with non-adjacent neighbors a, b and max(w(a), w(b)) <= w(v) < w(a) + w(b) is folded with its neighbors,
+ * - non-adjacent nodes with the same neighborhood are merged (twins).
+ *
+ * Every applied reduction is recorded, the solution of the kernel is lifted by replaying the record backwards.
+ * Optimal solutions of the kernel are lifted to optimal solutions of the input graph.
+ */
+class MWISReducer {
+    enum ReductionType {
+        REDUCTION_INCLUDE, // v is in the solution
+        REDUCTION_FOLD1,   // v of degree 1 was removed, the weight of its neighbor a was decreased by w(v)
+        REDUCTION_FOLD2,   // v now represents its neighbors a and b
+        REDUCTION_TWIN     // a was merged to its twin v
+    };
+
+    struct Reduction {
+        ReductionType type;
+        N_ID v;
+        N_ID a;
+        N_ID b;
+    };
+
+    int node_number;
+    vector<N_CONTAINER> adj;
+    vector<WTYPE> weights;
+    vector<char> alive;
+    WTYPE offset; // weight of the lifted solution minus the weight of the kernel solution
+    vector<Reduction> trace;
+
+    vector<N_ID> queue; // nodes whose neighborhood changed since they were checked
+    vector<char> in_queue;
+
+    vector<N_ID> kernel_nodes; // kernel_nodes[i] is the node corresponding to the node i of the kernel
+
+    void push(const N_ID& u);
+
+    /** Remove the node and schedule its neighbors for checking
+     *
+     * @param u taken by value, callers often pass an element of an adjacency set this erases
+     */
+    void remove_node(N_ID u);
+
+    /** Take the node in the solution and remove its closed neighborhood
+     *
+     */
+    void include_node(N_ID v);
+
+    /** Try all reductions on the node
+     *
+     * @return true if the graph was modified
+     */
+    bool reduce_node(const N_ID& v);
+
+    bool is_simplicial(const N_ID& v) const;
+    bool reduce_domination(const N_ID& v);
+    bool reduce_twin(const N_ID& v);
+    void fold_degree_two(const N_ID& v, const N_ID& a, const N_ID& b);
+
+public:
+    /** Copy the active part of the graph, inactive nodes are never in the solution
+     *
+     * @param G
+     */
+    explicit MWISReducer(const CSRGraph& G);
+
+    /** Apply the reductions until none of them applies
+     *
+     */
+    void reduce();
+
+    int get_kernel_size() const { return count(alive.begin(), alive.end(), 1); };
+
+    WTYPE get_offset() const { return offset; };
+
+    /** Build the reduced graph, its nodes are renumbered from 0
+     *
+     * @return
+     */
+    CSRGraph get_kernel();
+
+    /** Transform an independent set of the last built kernel to an independent set of the input graph
+     *
+     * @param kernel_solution nodes of the kernel
+     * @return the set has the weight of kernel_solution (with kernel weights) + get_offset()
+     */
+    N_CONTAINER lift(const N_CONTAINER& kernel_solution) const;
+};
+
+#endif //QUANTUM_BNP_REDUCTIONS_H
@@ -3,9 +3,13 @@
 //
 #include "mwis.h"
 #include "LocalSearch.h"
+#include "IndexedHeap.h"
+#include "../Settings.h"
 #include <functional>
 #include <list>
 #include <iostream>
+#include <mutex>
+#include <random>
 
 //Number of different permutations of the order
 #define N_ORDERS 5
@@ -14,88 +18,114 @@
 /** Find a Maximal Independent Set with respect to a given order
  *
   * @param graph
-  * @param priority the order of nodes
+  * @param priority the order of nodes, indexed by node
   * @param dynamic true if the order is modified after a vertex is added to a solution
-  * @param best_curr_is stores the best known independent set
-  * @param best_curr_weight stores the weight of the best indepedent set
+  * @param stop the construction is abandoned when it becomes true
+  * @return the maximal independent set improved with local search, empty if the construction was abandoned
+  * @note costs O((n + m) log n), nodes of equal priority are taken in increasing order
   */
-void maximalIS(const Graph& graph, unordered_map<int, WTYPE>& priority, bool dynamic, N_CONTAINER& best_curr_is, WTYPE& best_curr_weight)
+N_CONTAINER maximalIS(const CSRGraph& graph, const vector<WTYPE>& priority, bool dynamic, const atomic<bool>& stop)
 {
-    N_CONTAINER active_nodes = graph.get_active_nodes();
+    IndexedHeap candidates(graph.get_node_number());
+    for(const auto & u: graph.get_active_nodes())
+        candidates.push(u, priority[u]);
     N_CONTAINER IS;
 
     //Add active node with the highest priority
-    while (!active_nodes.empty())
+    while (!candidates.empty())
     {
-        //Find node with the highest priority
-        auto it = max_element(active_nodes.begin(), active_nodes.end(),
-                              [&priority](auto u, auto v) {return priority[u] < priority[v];});
-        N_ID u = *it;
+        if(stop)
+            return {};
+        N_ID u = candidates.pop();
 
         //Eliminate the neighbors and modify priorities if necessary
         for(const auto & v: graph.get_neighbors(u)) {
+            if(!candidates.contains(v))
+                continue;
+            candidates.erase(v);
             if(dynamic)
                 for(const auto & v_neighbor : graph.get_neighbors(v)){
-                    if(active_nodes.count(v_neighbor))
-                        priority[v_neighbor] += graph.get_node_weight(v_neighbor);
+                    if(candidates.contains(v_neighbor))
+                        candidates.update(v_neighbor, candidates.get_priority(v_neighbor) + graph.get_node_weight(v_neighbor));
                 }
-            active_nodes.erase(v);
         }
         IS.insert(u);
-        active_nodes.erase(u);
     }
 
     // Improve the greedy solution with local search
     LocalSearch ls(&graph);
     ls.improve(IS);
-
-    //If the maximal independent set is better than the best previously known set - modify it
-    WTYPE maximal_is_weight = graph.get_nodeset_weight(IS);
-    if(maximal_is_weight > best_curr_weight){
-        best_curr_is = IS;
-        best_curr_weight = maximal_is_weight;
-    }
+    return IS;
 }
 
 
 bool greedyMWIS(const Graph& graph, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff){
-    unordered_map<int, WTYPE> weight_priority;
+    return greedyMWIS(CSRGraph(graph), IS, IS_weight, cutoff);
+}
+
+bool greedyMWIS(const CSRGraph& graph, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff){
+    if(graph.get_active_nodes().empty())
+        return IS_weight > cutoff;
+
+    vector<WTYPE> weight_priority(graph.get_node_number(), 0);
     for (const auto & u: graph.get_active_nodes()){
         weight_priority[u] = graph.get_node_weight(u);
     }
 
-    unordered_map<int, WTYPE> surplus_priority = weight_priority;
+    vector<WTYPE> surplus_priority = weight_priority;
     for (const auto & u : graph.get_active_nodes()){
         for(const auto & v : graph.get_neighbors(u))
             surplus_priority[v] -= graph.get_node_weight(u);
     }
 
-    unordered_map<int, WTYPE> dynamic_surplus_priority = surplus_priority;
-
     WTYPE factor = graph.get_node_number() * graph.get_max_weight();
+    N_ID last_node = graph.get_active_nodes().back();
+
+    //Tasks 3 * i, 3 * i + 1, 3 * i + 2 use the weight, surplus and dynamic surplus orders
+    //where the element with the largest index was moved i times to the end of the order, the following tasks are randomized
+    int n_fixed = 3 * N_ORDERS;
+    int n_tasks = n_fixed + settings().greedy_random_starts;
+
+    //The incumbent is replaced by heavier sets, or by equally heavy sets of a smaller task for reproducibility
+    mutex incumbent_mutex;
+    int incumbent_task = -1;
+    atomic<bool> stop(IS_weight > cutoff);
+
+    parallel_for(n_tasks, [&](int task){
+        if(stop)
+            return;
+
+        vector<WTYPE> priority;
+        bool dynamic;
+        if(task < n_fixed) {
+            priority = task % 3 == 0 ? weight_priority : surplus_priority;
+            priority[last_node] -= (task / 3) * factor;
+            dynamic = task % 3 == 2;
+        }
+        else {
+            int start = task - n_fixed;
+            mt19937 generator(settings().seed + start);
+            uniform_real_distribution<WTYPE> perturbation(1 - GREEDY_PERTURBATION, 1 + GREEDY_PERTURBATION);
+            priority = start % 3 == 0 ? weight_priority : surplus_priority;
+            for(const auto & u: graph.get_active_nodes())
+                priority[u] *= perturbation(generator);
+            dynamic = start % 3 == 2;
+        }
 
-    //Iterate over different orders and first elements to get the best independent set
-
-    for(int i = 0; i < N_ORDERS; i++){
-
-        //Find is maximal sets for any of orders improves the current best known independent set
-        maximalIS(graph, weight_priority, false, IS, IS_weight);
-        maximalIS(graph, surplus_priority, false, IS, IS_weight);
-        maximalIS(graph, dynamic_surplus_priority, true, IS, IS_weight);
-
-        if(IS_weight > cutoff) break;
-
-        //Move the top element to the end of the list
-        auto it_w = max_element(weight_priority.begin(), weight_priority.end(), [](auto u, auto v){ return u.first < v.first; });
-        if(it_w!=weight_priority.end())
-            it_w->second -= factor;
-        
+        N_CONTAINER maximal_is = maximalIS(graph, priority, dynamic, stop);
+        if(stop)
+            return;
+        WTYPE maximal_is_weight = graph.get_nodeset_weight(maximal_is);
 
-        auto it_s = max_element(surplus_priority.begin(), surplus_priority.end(), [](auto u, auto v){ return u.first < v.first; });
-        if(it_s!=weight_priority.end())
-            it_s->second -= factor;
+        lock_guard<mutex> lock(incumbent_mutex);
+        if(maximal_is_weight > IS_weight || (maximal_is_weight == IS_weight && incumbent_task > task)) {
+            IS = std::move(maximal_is);
+            IS_weight = maximal_is_weight;
+            incumbent_task = task;
+        }
+        if(IS_weight > cutoff)
+            stop = true;
+    }, settings().threads);
 
-        dynamic_surplus_priority = surplus_priority;
-    }
-    return IS_weight > cutoff;
-}
\ No newline at end of file
+    return improve_with_ils(graph, IS, IS_weight, cutoff, settings().ils_post_time);
+}
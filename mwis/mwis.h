@@ -5,7 +5,15 @@
 #ifndef QUANTUM_BNP_MWIS_H
 #define QUANTUM_BNP_MWIS_H
 
+#include <functional>
 #include "../Graph.h"
+#include "../CSRGraph.h"
+#include "../Settings.h"
+
+/** A method that finds a weighted independent set of weight above some threshold, with the arguments of greedyMWIS
+ *
+ */
+using MWISSolver = function<bool(const CSRGraph&, N_CONTAINER&, WTYPE&, const WTYPE&)>;
 
 
 /** A greedy heuristic that finds a weighted independent set of weight above some threshold
@@ -20,9 +28,40 @@
  * @param cutoff
  * @return True if the method finds an independent set of weight > cutoff
  * @note The used orders are specified in the paper [Maximum-Weight Stable Sets and Safe Lower Bounds For Graph Coloring]
+ * @note The orders and settings().greedy_random_starts randomly perturbed orders run in parallel, all of them stop as soon as one
+ * finds a set of weight > cutoff. With cutoff = INF the result depends only on settings().seed.
+ * @note If settings().ils_post_time > 0 the result is improved with improve_with_ils
  */
 bool greedyMWIS(const Graph& G, N_CONTAINER& best_mwis, WTYPE & best_mwis_value, const WTYPE & cutoff);
 
+/** The greedy heuristic on a graph snapshot, avoids copying the graph when the caller already has one
+ *
+ * @see greedyMWIS(const Graph&, N_CONTAINER&, WTYPE&, const WTYPE&)
+ */
+bool greedyMWIS(const CSRGraph& G, N_CONTAINER& best_mwis, WTYPE & best_mwis_value, const WTYPE & cutoff);
+
+/** The greedy heuristic followed by an iterated local search with the time budget settings().ils_time
+ *
+ * @param G the input graph
+ * @param best_mwis in input constains the best previously known MWIS, is modified if the function finds a better solution
+ * @param best_mwis_value the value of best_mwis
+ * @param cutoff
+ * @return True if the method finds an independent set of weight > cutoff
+ * @see IteratedLocalSearch
+ */
+bool ilsMWIS(const CSRGraph& G, N_CONTAINER& best_mwis, WTYPE & best_mwis_value, const WTYPE & cutoff);
+
+/** Improve an independent set with an iterated local search, stops when the weight exceeds the cutoff
+ *
+ * @param G the input graph
+ * @param best_mwis the independent set, is modified if the search finds a better solution
+ * @param best_mwis_value the value of best_mwis
+ * @param cutoff
+ * @param time_limit in seconds, nothing is done if it is not positive
+ * @return True if best_mwis_value > cutoff
+ */
+bool improve_with_ils(const CSRGraph& G, N_CONTAINER& best_mwis, WTYPE & best_mwis_value, const WTYPE & cutoff, double time_limit);
+
 /** A quantum heuristic based on RQAOA that finds a weighted independent set of weight above some threshold
  *
  * The method defines the Hamiltonian corresponding to the MWIS problem. Independence constraint is enforced with penalties.
@@ -38,6 +77,42 @@ bool greedyMWIS(const Graph& G, N_CONTAINER& best_mwis, WTYPE & best_mwis_value,
  */
 bool quantumMWIS(const Graph& G, N_CONTAINER& best_mwis, WTYPE & best_mwis_value, const WTYPE & cutoff);
 
+/** The quantum heuristic on a graph snapshot
+ *
+ * @see quantumMWIS(const Graph&, N_CONTAINER&, WTYPE&, const WTYPE&)
+ */
+bool quantumMWIS(const CSRGraph& G, N_CONTAINER& best_mwis, WTYPE & best_mwis_value, const WTYPE & cutoff);
+
+/** Run a method on each connected component of the graph and merge the solutions
+ *
+ * Components with one or two nodes are solved directly, the other components are solved one after another, from the largest,
+ * as the solvers use all threads themselves. Each component gets the cutoff decreased by the weight found on the previous
+ * components and by the heaviest node of each next component, so the search stops as soon as the merged set exceeds the cutoff.
+ * A component whose solution is lighter than its heaviest node contributes this node.
+ *
+ * @param G the input graph
+ * @param solver the method applied to the components
+ * @param best_mwis in input constains the best previously known MWIS, is modified if the function finds a better solution
+ * @param best_mwis_value the value of best_mwis
+ * @param cutoff
+ * @return True if the method finds an independent set of weight > cutoff
+ */
+bool componentwiseMWIS(const CSRGraph& G, const MWISSolver& solver, N_CONTAINER& best_mwis, WTYPE & best_mwis_value, const WTYPE & cutoff);
+
+/** Run a method on the kernel of the graph obtained with MWIS reductions and lift its solution
+ *
+ * The reductions are exact (see MWISReducer), sparse graphs often shrink to a few nodes or vanish completely.
+ * The kernel is solved with componentwiseMWIS, with the cutoff decreased by the weight fixed by the reductions.
+ *
+ * @param G the input graph
+ * @param solver the method applied to the kernel
+ * @param best_mwis in input constains the best previously known MWIS, is modified if the function finds a better solution
+ * @param best_mwis_value the value of best_mwis
+ * @param cutoff
+ * @return True if the method finds an independent set of weight > cutoff
+ */
+bool reducedMWIS(const CSRGraph& G, const MWISSolver& solver, N_CONTAINER& best_mwis, WTYPE & best_mwis_value, const WTYPE & cutoff);
+
 /** An exact method based on Branching that finds a weighted independent set of weight above some threshold
  *
  * The method stops when it find a set of weight < threshold. If threshold = INF the method finds an exact optimal solution
@@ -0,0 +1,176 @@
+//
+// Created on 17/10/26.
+//
+
+#include "CorrelationCache.h"
+
+CorrelationCache::CorrelationCache(const Hamiltonian* h): h(h), initialized(false), reference({0, 0}), z(h->allocated, 0),
+        best_near(h->allocated), near_values(h->allocated), is_pending(h->allocated, 0), mark(h->allocated, -1), stamp(0) {}
+
+void CorrelationCache::add_pending(const N_ID &u) {
+    if(!is_pending[u]) {
+        is_pending[u] = 1;
+        pending.push_back(u);
+    }
+}
+
+template<class F>
+void CorrelationCache::mark_ball(const N_ID &u, vector<int> &marks, int marker, F visit) const {
+    marks[u] = marker;
+    for(const auto& x: h->interactions[u].nodes) {
+        if(marks[x] != marker) {
+            marks[x] = marker;
+            visit(x);
+        }
+        for(const auto& y: h->interactions[x].nodes)
+            if(marks[y] != marker) {
+                marks[y] = marker;
+                visit(y);
+            }
+    }
+}
+
+void CorrelationCache::invalidate(const Constraint &c) {
+    //The constraint changes the linear terms and the rows of c.v and of the neighbors of c.u, the entries of a node
+    //depend on the terms of the nodes at distance at most 2
+    vector<N_ID> modified(h->interactions[c.u].nodes);
+    if(c.v != -1)
+        modified.push_back(c.v);
+    stamp++;
+    for(const auto& x: modified) {
+        add_pending(x);
+        mark_ball(x, mark, stamp, [this](N_ID y){ add_pending(y); });
+    }
+
+    near_values.erase(c.u);
+    order.erase({-abs(z[c.u]), c.u});
+}
+
+void CorrelationCache::refresh(const Parameters &p) {
+    TrigTable trig(p.gamma, h->coefficient_bound());
+    vector<N_ID> nodes;
+    for(const auto& u: pending) {
+        is_pending[u] = 0;
+        //Nodes eliminated after they were scheduled
+        if(h->active_nodes.count(u))
+            nodes.push_back(u);
+    }
+    pending.clear();
+    int size = nodes.size();
+
+    vector<double> new_z(size);
+#pragma omp parallel for schedule(dynamic, 16) num_threads(settings().threads) if(size > 64)
+    for(int i = 0; i < size; i++)
+        new_z[i] = h->z_mean(nodes[i], p, trig);
+    for(int i = 0; i < size; i++) {
+        N_ID u = nodes[i];
+        order.erase({-abs(z[u]), u});
+        z[u] = new_z[i];
+        order.insert({-abs(z[u]), u});
+    }
+
+#pragma omp parallel num_threads(settings().threads) if(size > 64)
+    {
+        vector<int> marks(h->allocated, -1);
+#pragma omp for schedule(dynamic, 1)
+        for(int i = 0; i < size; i++) {
+            N_ID u = nodes[i];
+            Correlation output = make_correlation(z[u], u, -1);
+            mark_ball(u, marks, u, [&](N_ID v){
+                if(v > u) {
+                    auto candidate = make_correlation(h->zz_mean(u, v, p, trig), u, v);
+                    if(candidate.better_than(output))
+                        output = candidate;
+                }
+            });
+            best_near[u] = output;
+        }
+    }
+    for(const auto& u: nodes)
+        near_values.push_or_update(u, best_near[u].value);
+}
+
+Constraint CorrelationCache::find_max_correlation(const Parameters &p) {
+    double tolerance = settings().correlation_tolerance;
+    if(!initialized || abs(p.beta - reference.beta) > tolerance || abs(p.gamma - reference.gamma) > tolerance) {
+        initialized = true;
+        reference = p;
+        for(const auto& u: h->active_nodes)
+            add_pending(u);
+    }
+    refresh(p);
+
+    Correlation output = {0, {1, *h->active_nodes.begin(), -1}};
+    if(!near_values.empty() && best_near[near_values.top()].better_than(output))
+        output = best_near[near_values.top()];
+
+    //Best pair at distance > 2: for each u by decreasing |<Z_u>|, its best partner is the first node of the order that is not close to u.
+    //The products are bounded by |<Z_u>| times the largest |<Z>|, the search stops when the bound can't beat the output
+    if(order.empty())
+        return output.constraint;
+    double max_z = -order.begin()->first;
+    for(const auto& [key_u, u]: order) {
+        double bound = -key_u * max_z;
+        if(bound < output.value || bound == 0)
+            break;
+        stamp++;
+        mark_ball(u, mark, stamp, [](N_ID){});
+        for(const auto& [key_v, v]: order)
+            if(mark[v] != stamp) {
+                auto candidate = make_correlation(z[u] * z[v], min(u, v), max(u, v));
+                if(candidate.better_than(output))
+                    output = candidate;
+                break;
+            }
+    }
+//    cout << "Maximum correlation: " << output.value << "; ";
+    return output.constraint;
+}
+
+void CorrelationCache::mark_light_cone(const Constraint &c) {
+    for(const auto& u: {c.u, c.v}) {
+        if(u == -1)
+            continue;
+        mark[u] = stamp;
+        for(const auto& x: h->interactions[u].nodes)
+            mark[x] = stamp;
+    }
+}
+
+bool CorrelationCache::light_cone_is_free(const Constraint &c) const {
+    for(const auto& u: {c.u, c.v}) {
+        if(u == -1)
+            continue;
+        if(mark[u] == stamp)
+            return false;
+        for(const auto& x: h->interactions[u].nodes)
+            if(mark[x] == stamp)
+                return false;
+    }
+    return true;
+}
+
+vector<Constraint> CorrelationCache::find_max_correlations(const Parameters &p, int k) {
+    vector<Constraint> batch = {find_max_correlation(p)};
+    if(k <= 1)
+        return batch;
+
+    stamp++;
+    mark_light_cone(batch[0]);
+    vector<N_ID> popped;
+    while((int) batch.size() < k && !near_values.empty()) {
+        N_ID u = near_values.pop();
+        popped.push_back(u);
+        const auto& candidate = best_near[u];
+        //The remaining terms carry no information
+        if(candidate.value == 0)
+            break;
+        if(light_cone_is_free(candidate.constraint)) {
+            mark_light_cone(candidate.constraint);
+            batch.push_back(candidate.constraint);
+        }
+    }
+    for(const auto& u: popped)
+        near_values.push(u, best_near[u].value);
+    return batch;
+}
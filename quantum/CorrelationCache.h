@@ -0,0 +1,113 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_CORRELATIONCACHE_H
+#define QUANTUM_BNP_CORRELATIONCACHE_H
+
+#include <set>
+#include "Hamiltonian.h"
+#include "../mwis/IndexedHeap.h"
+
+/** A candidate constraint with the absolute value of its correlation
+ *
+ * Among equal values the smallest (u, v) wins, v = -1 for Z_u: it is the first maximum of the scan over u and then Z_u, Z_uZ_v by increasing v.
+ */
+using Correlation = struct Correlation {
+    double value;
+    Constraint constraint;
+
+    bool better_than(const Correlation& other) const {
+        if(value != other.value)
+            return value > other.value;
+        return make_pair(constraint.u, constraint.v) < make_pair(other.constraint.u, other.constraint.v);
+    }
+};
+
+/** The candidate constraint of the term Z_u (v = -1) or Z_uZ_v with the mean value val
+ *
+ */
+inline Correlation make_correlation(double val, N_ID u, N_ID v) {
+    return {abs(val), {val < 0 ? -1 : 1, u, v}};
+}
+
+/** Correlations of the QAOA_1 state of a Hamiltonian kept across the steps of RQAOA
+ *
+ * For each active node u the cache stores <Z_u> and the best constraint among Z_u and Z_uZ_v for v > u at distance at most 2
+ * in the interaction graph, the nodes are kept in an indexed priority queue by the value of this constraint.
+ * Farther pairs factorize, <Z_uZ_v> = <Z_u><Z_v>, the best of them is searched from the nodes sorted by |<Z_u>|.
+ *
+ * A constraint only changes the terms around the eliminated node, so only the nodes at distance at most 2 from the modified
+ * nodes are recomputed. All entries are recomputed when beta or gamma moved by more than settings().correlation_tolerance
+ * since the last full refresh, in between the other entries keep the values of older parameters.
+ */
+class CorrelationCache {
+    const Hamiltonian* h;
+
+    bool initialized;
+    Parameters reference; // parameters of the last full refresh
+
+    vector<double> z; // <Z_u> of each active node
+    vector<Correlation> best_near; // best constraint of u among Z_u and Z_uZ_v for v > u at distance at most 2
+    IndexedHeap near_values; // active nodes by the value of best_near
+    set<pair<double, N_ID>> order; // active nodes by decreasing |<Z_u>|, the key is (-|<Z_u>|, u)
+
+    vector<N_ID> pending; // nodes to recompute
+    vector<char> is_pending;
+    vector<int> mark; // mark[x] == stamp if x was visited by the last neighborhood search
+    int stamp;
+
+    void add_pending(const N_ID& u);
+
+    /** Mark the nodes at distance at most 2 from u
+     *
+     * @param visit called for every marked node other than u
+     */
+    template<class F>
+    void mark_ball(const N_ID& u, vector<int>& marks, int marker, F visit) const;
+
+    /** Mark the light cone of the constraint, the closed neighborhoods of its nodes, with the current stamp
+     *
+     */
+    void mark_light_cone(const Constraint& c);
+
+    /** Check that no node of the light cone of the constraint is marked with the current stamp
+     *
+     */
+    bool light_cone_is_free(const Constraint& c) const;
+
+    /** Recompute the entries of the pending nodes
+     *
+     */
+    void refresh(const Parameters& p);
+
+public:
+    explicit CorrelationCache(const Hamiltonian* h);
+
+    /** Record the nodes whose entries change when the constraint is added, must be called before Hamiltonian::add_constraint
+     *
+     * @param c
+     */
+    void invalidate(const Constraint& c);
+
+    /** Find the variable or the pair of variables with the largest absolute correlation in the QAOA_1 state
+     *
+     * @param p
+     * @return the constraint fixing the sign of the most correlated term, ties are broken by the smallest (u, v)
+     */
+    Constraint find_max_correlation(const Parameters& p);
+
+    /** Find up to k strongly correlated terms whose constraints can be added together
+     *
+     * The first one is find_max_correlation(p), the others are the best constraints of the nodes in decreasing order of correlation
+     * whose light cones N[u] + N[v] don't intersect the light cones of the already selected ones. Adding one of them doesn't change
+     * the terms the others depend on.
+     *
+     * @param p
+     * @param k
+     * @return the constraints, in decreasing order of correlation
+     */
+    vector<Constraint> find_max_correlations(const Parameters& p, int k);
+};
+
+#endif //QUANTUM_BNP_CORRELATIONCACHE_H
@@ -3,29 +3,48 @@
 //
 
 #include "Hamiltonian.h"
+#include "CorrelationCache.h"
+#include "StateVector.h"
+#include "LightCone.h"
 #include "../mwis/LocalSearch.h"
+#include "../mwis/mwis.h"
 #include "nlopt.hpp"
 #include <cmath>
 #include <iostream>
 #include <chrono>
 #include <climits>
 #include <numeric>
+#include <algorithm>
+#include <memory>
 
 // Time budget for global parameter optimization routine
 
 #define MAX_OPT_TIME 10
 
-void Hamiltonian::update_common_neighbors() {
-    for(const auto& u: active_nodes)
-        for(const auto& v: active_nodes)
-            if(u < v) {
-                common_neighbors[u][v] = neighbors[u];
-                common_neighbors[u][v].insert(neighbors[v].begin(), neighbors[v].end());
-                common_neighbors[u][v].erase(u);
-                common_neighbors[u][v].erase(v);
-                common_neighbors[v][u] = common_neighbors[u][v];
-            }
-    return;
+// Budget of objective evaluations of the global parameter search when the local searches use the gradient
+
+#define MAX_OPT_EVALUATIONS 1000
+
+// Number of chunks of the brute-force search space per thread
+
+#define BF_CHUNKS_PER_THREAD 16
+
+void Hamiltonian::set_interaction(InteractionRow &row, const N_ID &v, CTYPE weight) {
+    auto it = lower_bound(row.nodes.begin(), row.nodes.end(), v);
+    auto i = it - row.nodes.begin();
+    bool present = it != row.nodes.end() && *it == v;
+    if(abs(weight) < EPSILON) {
+        if(present) {
+            row.nodes.erase(it);
+            row.coefficients.erase(row.coefficients.begin() + i);
+        }
+    }
+    else if(present)
+        row.coefficients[i] = weight;
+    else {
+        row.nodes.insert(it, v);
+        row.coefficients.insert(row.coefficients.begin() + i, weight);
+    }
 }
 
 void Hamiltonian::set_linear(const N_ID &u, CTYPE weight) {
@@ -33,68 +52,194 @@ void Hamiltonian::set_linear(const N_ID &u, CTYPE weight) {
 }
 
 void Hamiltonian::set_quadratic(const N_ID &u, const N_ID &v, CTYPE weight) {
-    if(abs(weight) < EPSILON)
-    {
-        neighbors[u].erase(v);
-        neighbors[v].erase(u);
-    }
-    else
-    {
-        neighbors[u].insert(v);
-        neighbors[v].insert(u);
+    set_interaction(interactions[u], v, weight);
+    set_interaction(interactions[v], u, weight);
+}
+
+CTYPE Hamiltonian::get_quadratic(const N_ID &u, const N_ID &v) const {
+    const auto& row = interactions[u].nodes.size() <= interactions[v].nodes.size() ? interactions[u] : interactions[v];
+    N_ID x = &row == &interactions[u] ? v : u;
+    auto it = lower_bound(row.nodes.begin(), row.nodes.end(), x);
+    if(it == row.nodes.end() || *it != x)
+        return 0;
+    return row.coefficients[it - row.nodes.begin()];
+}
+
+int Hamiltonian::coefficient_bound() const {
+    CTYPE max_coefficient = 0;
+    for(const auto& u: active_nodes) {
+        max_coefficient = max(max_coefficient, abs(linear[u]));
+        for(const auto& J: interactions[u].coefficients)
+            max_coefficient = max(max_coefficient, abs(J));
     }
-    quadratic[u*allocated + v] = quadratic[v*allocated + u] = weight;
+    //Sums and differences of two coefficients appear in zz_mean
+    return 2 * max_coefficient;
 }
 
 double Hamiltonian::z_mean(const N_ID &u, const Parameters &p) const {
-    if (abs(linear[u]) < EPSILON) return 0;
-    double zu = sin(p.beta) * sin(p.gamma * linear[u]);
-    for(const auto & v: neighbors[u])
-        zu *= cos(p.gamma * quadratic[u*allocated + v]);
-    return zu;
+    return z_mean(u, p, TrigTable(p.gamma, coefficient_bound()));
 }
 
 double Hamiltonian::zz_mean(const N_ID &u, const N_ID &v, const Parameters &p) const {
-    double zuv = 0;
-    if( abs(quadratic[u*allocated + v]) > EPSILON)
-    {
-        double cu = cos(p.gamma * linear[u]);
-        for(const auto & x : neighbors[u])
-            if(x != v)
-                cu *= cos(p.gamma * quadratic[u*allocated + x]);
-        double cv = cos(p.gamma * linear[v]);
-        for(const auto & x: neighbors[v])
-            if(x != u)
-                cv *= cos(p.gamma * quadratic[v*allocated + x]);
-        zuv = sin(2*p.beta)*sin(p.gamma * quadratic[u*allocated + v])*(cu + cv);
+    return zz_mean(u, v, p, TrigTable(p.gamma, coefficient_bound()));
+}
+
+double Hamiltonian::z_mean(const N_ID &u, const Parameters &p, const TrigTable &trig, double* gradient) const {
+    if (abs(linear[u]) < EPSILON) return 0;
+    const auto& row = interactions[u];
+    if(!gradient)
+        return sin(p.beta) * trig.sin(linear[u]) * trig.cos_product(row.coefficients.data(), row.coefficients.size());
+
+    double product_derivative;
+    double product = trig.cos_product(row.coefficients.data(), row.coefficients.size(), product_derivative);
+    double s = trig.sin(linear[u]);
+    gradient[0] += cos(p.beta) * s * product;
+    gradient[1] += sin(p.beta) * (linear[u] * trig.cos(linear[u]) * product + s * product_derivative);
+    return sin(p.beta) * s * product;
+}
+
+double Hamiltonian::zz_mean(const N_ID &u, const N_ID &v, const Parameters &p, const TrigTable &trig, double* gradient) const {
+    const auto& row_u = interactions[u];
+    const auto& row_v = interactions[v];
+    int size_u = row_u.nodes.size();
+    int size_v = row_v.nodes.size();
+
+    //Merge the two sorted rows to iterate over the union of the neighborhoods, a node missing in a row has the coefficient 0 there
+    //The derivatives with respect to gamma of the products are accumulated with the product rule
+    int v_in_u = -1, u_in_v = -1; // positions of v in the row of u and of u in the row of v
+    CTYPE plus = linear[u] + linear[v], minus = linear[u] - linear[v];
+    double cplus = trig.cos(plus);
+    double cminus = trig.cos(minus);
+    double dplus = -plus * trig.sin(plus);
+    double dminus = -minus * trig.sin(minus);
+    int i = 0, j = 0;
+    while(i < size_u || j < size_v) {
+        N_ID x;
+        CTYPE j_ux = 0, j_vx = 0;
+        if(j == size_v || (i < size_u && row_u.nodes[i] < row_v.nodes[j])) {
+            x = row_u.nodes[i];
+            j_ux = row_u.coefficients[i++];
+        }
+        else if(i == size_u || row_v.nodes[j] < row_u.nodes[i]) {
+            x = row_v.nodes[j];
+            j_vx = row_v.coefficients[j++];
+        }
+        else {
+            x = row_u.nodes[i];
+            j_ux = row_u.coefficients[i++];
+            j_vx = row_v.coefficients[j++];
+        }
+        if(x == v) {
+            v_in_u = i - 1;
+            continue;
+        }
+        if(x == u) {
+            u_in_v = j - 1;
+            continue;
+        }
+        plus = j_ux + j_vx;
+        minus = j_ux - j_vx;
+        double c = trig.cos(plus);
+        if(gradient)
+            dplus = dplus * c - plus * trig.sin(plus) * cplus;
+        cplus *= c;
+        c = trig.cos(minus);
+        if(gradient)
+            dminus = dminus * c - minus * trig.sin(minus) * cminus;
+        cminus *= c;
+    }
+
+    double sin_beta2 = sin(p.beta) * sin(p.beta);
+    double zuv = sin_beta2 * (cminus - cplus);
+    if(gradient) {
+        gradient[0] += sin(2*p.beta) * (cminus - cplus) / 2;
+        gradient[1] += sin_beta2 * (dminus - dplus) / 2;
     }
-    double cplus = cos(p.gamma * (linear[u] + linear[v]));
-    double cminus = cos(p.gamma * (linear[u] - linear[v]));
-    for(const auto & x: common_neighbors[u][v])
+    if(v_in_u != -1)
     {
-        cplus *= cos(p.gamma * (quadratic[u*allocated + x] + quadratic[v*allocated + x]));
-        cminus *= cos(p.gamma * (quadratic[u*allocated + x] - quadratic[v*allocated + x]));
+        //Products over the rows without the term Z_uZ_v
+        const CTYPE* coeff_u = row_u.coefficients.data();
+        const CTYPE* coeff_v = row_v.coefficients.data();
+        CTYPE j_uv = coeff_u[v_in_u];
+        if(!gradient) {
+            double cu = trig.cos(linear[u]) * trig.cos_product(coeff_u, v_in_u) * trig.cos_product(coeff_u + v_in_u + 1, size_u - v_in_u - 1);
+            double cv = trig.cos(linear[v]) * trig.cos_product(coeff_v, u_in_v) * trig.cos_product(coeff_v + u_in_v + 1, size_v - u_in_v - 1);
+            zuv += sin(2*p.beta)*trig.sin(j_uv)*(cu + cv);
+        }
+        else {
+            //Derivative of cos(gamma l) * (product before k) * (product after k)
+            auto row_product = [&trig](CTYPE l, const CTYPE* coeff, int k, int size, double& derivative) {
+                double d1, d2;
+                double p1 = trig.cos_product(coeff, k, d1);
+                double p2 = trig.cos_product(coeff + k + 1, size - k - 1, d2);
+                double c = trig.cos(l);
+                derivative = -l * trig.sin(l) * p1 * p2 + c * (d1 * p2 + p1 * d2);
+                return c * p1 * p2;
+            };
+            double du, dv;
+            double cu = row_product(linear[u], coeff_u, v_in_u, size_u, du);
+            double cv = row_product(linear[v], coeff_v, u_in_v, size_v, dv);
+            double s = trig.sin(j_uv);
+            zuv += sin(2*p.beta) * s * (cu + cv);
+            gradient[0] += cos(2*p.beta) * s * (cu + cv);
+            gradient[1] += sin(2*p.beta) * (j_uv * trig.cos(j_uv) * (cu + cv) + s * (du + dv)) / 2;
+        }
     }
-    zuv += (sin(p.beta) * sin(p.beta))*(cminus - cplus);
     return zuv/2;
 }
 
-double Hamiltonian::qaoa_mean(const Parameters &p) const {
-    double mean = 0;
-    for(auto it1 = active_nodes.begin(); it1 != active_nodes.end(); it1++) {
+double Hamiltonian::qaoa_mean(const Parameters &p, double* gradient) const {
+    //All angles are multiples of gamma, their cosines and sines are tabulated once per evaluation
+    TrigTable trig(p.gamma, coefficient_bound());
+    vector<N_ID> nodes(active_nodes.begin(), active_nodes.end());
+    int size = nodes.size();
+
+    //The terms of each node are summed in parallel, the partial sums are added in the order of the nodes so that
+    //the result doesn't depend on the number of threads
+    vector<double> node_mean(size, 0);
+    vector<double> node_gradient(gradient ? 2 * size : 0, 0);
+#pragma omp parallel for schedule(dynamic, 16) num_threads(settings().threads)
+    for(int i = 0; i < size; i++) {
+        N_ID u = nodes[i];
+        double term_gradient[2];
+        double* g = gradient ? &node_gradient[2 * i] : nullptr;
+        if(abs(linear[u]) >= EPSILON) {
+            term_gradient[0] = term_gradient[1] = 0;
+            node_mean[i] += linear[u] * z_mean(u, p, trig, g ? term_gradient : nullptr);
+            if(g) {
+                g[0] += linear[u] * term_gradient[0];
+                g[1] += linear[u] * term_gradient[1];
+            }
+        }
+        const auto& row = interactions[u];
+        for(int k = 0; k < (int) row.nodes.size(); k++)
+            if(row.nodes[k] > u) {
+                term_gradient[0] = term_gradient[1] = 0;
+                node_mean[i] += row.coefficients[k] * zz_mean(u, row.nodes[k], p, trig, g ? term_gradient : nullptr);
+                if(g) {
+                    g[0] += row.coefficients[k] * term_gradient[0];
+                    g[1] += row.coefficients[k] * term_gradient[1];
+                }
+            }
+    }
 
-        if(!abs(linear[*it1]) < EPSILON)
-            mean += linear[*it1] * z_mean(*it1, p);
-        for(auto it2 = next(it1); it2 != active_nodes.end(); it2++)
-            if(!abs(quadratic[*it1*allocated + *it2]) < EPSILON)
-                mean += quadratic[*it1*allocated + *it2] * zz_mean(*it1, *it2, p);
+    double mean = 0;
+    if(gradient)
+        gradient[0] = gradient[1] = 0;
+    for(int i = 0; i < size; i++) {
+        mean += node_mean[i];
+        if(gradient) {
+            gradient[0] += node_gradient[2 * i];
+            gradient[1] += node_gradient[2 * i + 1];
+        }
     }
     return mean;
 }
 
 void Hamiltonian::remove_node(const N_ID &u) {
-    for (const auto &v: neighbors[u])
-        neighbors[v].erase(u);
+    for (const auto &v: interactions[u].nodes)
+        set_interaction(interactions[v], u, 0);
+    interactions[u] = InteractionRow();
 
     active_nodes.erase(u);
     actual_node_number--;
@@ -102,31 +247,84 @@ void Hamiltonian::remove_node(const N_ID &u) {
 
 void Hamiltonian::add_constraint(Constraint c) {
     constraints.push_back(c);
-    if(c.v != -1)
+    const auto& row_u = interactions[c.u];
+    if(c.v == -1) {
+        for(int k = 0; k < (int) row_u.nodes.size(); k++)
+            set_linear(row_u.nodes[k], linear[row_u.nodes[k]] + c.sigma * row_u.coefficients[k]);
+    }
+    else {
         linear[c.v] += c.sigma * linear[c.u];
-    for(const auto& w: neighbors[c.u])
-        if(w != c.v) {
-            if (c.v != -1)
-                set_quadratic(c.v, w, quadratic[c.v * allocated + w] + c.sigma * quadratic[c.u * allocated + w]);
-            else
-                set_linear(w, linear[w] + c.sigma * quadratic[c.u * allocated + w]);
+
+        //Substitute Z_u = sigma Z_v: merge sigma * (row of u) into the row of v in one pass,
+        //besides these two rows only the entries of v in the rows of the neighbors of u change
+        const auto& row_v = interactions[c.v];
+        int size_u = row_u.nodes.size();
+        int size_v = row_v.nodes.size();
+        InteractionRow merged;
+        merged.nodes.reserve(size_u + size_v);
+        merged.coefficients.reserve(size_u + size_v);
+        int i = 0, j = 0;
+        while(i < size_u || j < size_v) {
+            N_ID x;
+            CTYPE weight;
+            bool from_u = false;
+            if(j == size_v || (i < size_u && row_u.nodes[i] < row_v.nodes[j])) {
+                x = row_u.nodes[i];
+                weight = c.sigma * row_u.coefficients[i++];
+                from_u = true;
+            }
+            else if(i == size_u || row_v.nodes[j] < row_u.nodes[i]) {
+                x = row_v.nodes[j];
+                weight = row_v.coefficients[j++];
+            }
+            else {
+                x = row_u.nodes[i];
+                weight = row_v.coefficients[j++] + c.sigma * row_u.coefficients[i++];
+                from_u = true;
+            }
+            //The term Z_uZ_v becomes a constant
+            if(x == c.u || x == c.v)
+                continue;
+            if(from_u)
+                set_interaction(interactions[x], c.v, weight);
+            if(abs(weight) >= EPSILON) {
+                merged.nodes.push_back(x);
+                merged.coefficients.push_back(weight);
+            }
         }
+        interactions[c.v] = std::move(merged);
+    }
     remove_node(c.u);
     return;
 }
 
 
 
+namespace {
+    /** Run the optimizer from x, a search stopped by roundoff errors is not an error
+     *
+     * NLopt throws nlopt::roundoff_limited when the objective can't be improved with the floating point precision, the gradient-based
+     * methods hit it near flat optima. x and value are then left at the best point found, which is kept.
+     */
+    void run_optimizer(nlopt::opt& optimizer, vector<double>& x, double& value) {
+        try {
+            optimizer.optimize(x, value);
+        }
+        catch (const nlopt::roundoff_limited&) {
+        }
+    }
+}
+
 void Hamiltonian::optimize_parameters(Parameters& p, bool& in_neighborhood) const {
 
     // Compute how much time takes the optimization
 
     auto start = std::chrono::system_clock::now();
 
-    //The objective function
-    auto f = [](const vector<double> &x, vector<double>&, void* f_data){
+    //The objective function, the gradient is computed in the same pass when the algorithm asks for it
+    auto f = [](const vector<double> &x, vector<double>& grad, void* f_data){
         auto instance = (Hamiltonian* ) f_data;
-        return instance->qaoa_mean({x[0], x[1]});
+        return instance->qaoa_mean({x[0], x[1]}, grad.empty() ? nullptr : grad.data());
     };
 
     //The parameter vector
@@ -136,51 +334,75 @@ void Hamiltonian::optimize_parameters(Parameters& p, bool& in_neighborhood) cons
     double opt_val;
 
     // Set up the optimizer
-    nlopt::opt local_optimizer(nlopt::algorithm::LN_BOBYQA, 2);
+    nlopt::algorithm local_algorithm = nlopt::algorithm::LD_LBFGS;
+    if(settings().qaoa_optimizer == QAOA_OPTIMIZER_MMA)
+        local_algorithm = nlopt::algorithm::LD_MMA;
+    else if(settings().qaoa_optimizer == QAOA_OPTIMIZER_BOBYQA)
+        local_algorithm = nlopt::algorithm::LN_BOBYQA;
 
-    //Termination condition
-    local_optimizer.set_xtol_abs(0.0001);
-    local_optimizer.set_ftol_rel(0.01);
+    //One search with the given local method, the global search is skipped if the initial point is given
+    auto search = [&](nlopt::algorithm local_algorithm) {
+        nlopt::opt local_optimizer(local_algorithm, 2);
 
-    //If the initial point is not specified find it with a global search
+        //Termination condition
+        local_optimizer.set_xtol_abs(0.0001);
+        local_optimizer.set_ftol_rel(0.01);
 
-    if(!in_neighborhood) {
-        //Optimization routines
-        nlopt::opt global_optimizer(nlopt::algorithm::GD_MLSL, 2);
-        global_optimizer.set_local_optimizer(local_optimizer);
+        //If the initial point is not specified find it with a global search
 
-        //Set the objective
-        global_optimizer.set_min_objective(f, (void *) this);
+        if(!in_neighborhood) {
+            //Optimization routines
+            nlopt::opt global_optimizer(nlopt::algorithm::GD_MLSL, 2);
+            global_optimizer.set_local_optimizer(local_optimizer);
 
-        //Bounds
-        global_optimizer.set_population(actual_node_number);
-        global_optimizer.set_lower_bounds(0);
+            //Set the objective
+            global_optimizer.set_min_objective(f, (void *) this);
 
-        //Termination condition
-        global_optimizer.set_upper_bounds(2* M_PI);
-        global_optimizer.set_xtol_abs(0.001);
-        global_optimizer.set_maxtime(MAX_OPT_TIME);
+            //Bounds
+            global_optimizer.set_population(actual_node_number);
+            global_optimizer.set_lower_bounds(0);
 
-        global_optimizer.optimize(opt_x, opt_val);
-    }
-    else
-    {
-        opt_x[0] = p.beta;
-        opt_x[1] = p.gamma;
-    }
+            //Termination condition
+            global_optimizer.set_upper_bounds(2* M_PI);
+            global_optimizer.set_xtol_abs(0.001);
+            global_optimizer.set_maxtime(MAX_OPT_TIME);
+
+            //Gradient-based local searches converge in a few evaluations, the multistart search doesn't need the whole time budget
+            if(local_algorithm != nlopt::algorithm::LN_BOBYQA)
+                global_optimizer.set_maxeval(MAX_OPT_EVALUATIONS);
+
+            run_optimizer(global_optimizer, opt_x, opt_val);
+        }
+        else
+        {
+            opt_x[0] = p.beta;
+            opt_x[1] = p.gamma;
+        }
 
-    //Search around the initialization point with a local method
+        //Search around the initialization point with a local method
 
-    //Set bounds
-    local_optimizer.set_lower_bounds(0);
-    local_optimizer.set_upper_bounds(2* M_PI);
+        //Set bounds
+        local_optimizer.set_lower_bounds(0);
+        local_optimizer.set_upper_bounds(2* M_PI);
 
-    //Strengthen the termination  condition
-    local_optimizer.set_ftol_rel(0.001);
-    local_optimizer.set_maxtime(MAX_OPT_TIME);
+        //Strengthen the termination  condition
+        local_optimizer.set_ftol_rel(0.001);
+        local_optimizer.set_maxtime(MAX_OPT_TIME);
 
-    local_optimizer.set_min_objective(f, (void *) this);
-    local_optimizer.optimize(opt_x, opt_val);
+        local_optimizer.set_min_objective(f, (void *) this);
+        run_optimizer(local_optimizer, opt_x, opt_val);
+    };
+
+    //The line search of the gradient methods can break down on energies that oscillate quickly in gamma, as on dense graphs,
+    //NLopt then fails without returning a point and the search is run again without the gradient
+    try {
+        search(local_algorithm);
+    }
+    catch (const runtime_error&) {
+        if(local_algorithm == nlopt::algorithm::LN_BOBYQA)
+            throw;
+        search(nlopt::algorithm::LN_BOBYQA);
+    }
 
     auto elapsed_seconds = std::chrono::system_clock::now()-start;
     p.beta = opt_x[0];
@@ -189,89 +411,281 @@ void Hamiltonian::optimize_parameters(Parameters& p, bool& in_neighborhood) cons
 //    cout << "Optimal parameters: " << opt_x[0] << " " << opt_x[1] << endl;
 }
 
-Constraint Hamiltonian::find_max_correlation(const Parameters &p) {
-    Constraint output = {1, *active_nodes.begin(), -1};
-    double max_abs_corr_value = 0;
-    for(auto const & u: active_nodes)
-    {
-        double val = z_mean(u, p);
-        if ( abs(val) > max_abs_corr_value)
-        {
-            max_abs_corr_value = abs(val);
-            int sigma = val < 0 ? -1 : 1;
-            output = {sigma, u, -1};
-        }
-        for(auto const &v : active_nodes)
-            if(u < v)
-            {
-                double val = zz_mean(u, v, p);
-                if (abs(val) > max_abs_corr_value)
-                {
-                    max_abs_corr_value = abs(val);
-                    int sigma = val < 0 ? -1 : 1;
-                    output = {sigma, u, v};
-                }
-            }
+template<class Simulator>
+void Hamiltonian::optimize_layers(vector<Parameters>& layers, Simulator& simulator) const {
+    //The objective function, x stores beta and gamma of each layer
+    auto f = [](const vector<double> &x, vector<double>&, void* f_data){
+        auto simulator = (Simulator* ) f_data;
+        vector<Parameters> layers(x.size() / 2);
+        for(int k = 0; k < (int) layers.size(); k++)
+            layers[k] = {x[2 * k], x[2 * k + 1]};
+        return simulator->qaoa_mean(layers);
+    };
+
+    //The interpolated layers may have negative angles, the bounds cover a period of the circuit in each parameter.
+    //NLopt rejects a start outside of the bounds, the optimizers can return a point a rounding error beyond them
+    vector<double> opt_x(2 * layers.size());
+    for(int k = 0; k < (int) layers.size(); k++) {
+        opt_x[2 * k] = clamp(layers[k].beta, -2 * M_PI, 2 * M_PI);
+        opt_x[2 * k + 1] = clamp(layers[k].gamma, -2 * M_PI, 2 * M_PI);
     }
-//    cout << "Maximum correlation: " << max_abs_corr_value << "; ";
-    return output;
+    double opt_val;
+
+    nlopt::opt local_optimizer(nlopt::algorithm::LN_BOBYQA, opt_x.size());
+    local_optimizer.set_lower_bounds(-2 * M_PI);
+    local_optimizer.set_upper_bounds(2 * M_PI);
+    local_optimizer.set_xtol_abs(0.0001);
+    local_optimizer.set_ftol_rel(0.001);
+    local_optimizer.set_maxtime(MAX_OPT_TIME);
+    local_optimizer.set_maxeval(MAX_OPT_EVALUATIONS);
+    local_optimizer.set_min_objective(f, (void *) &simulator);
+    run_optimizer(local_optimizer, opt_x, opt_val);
+
+    for(int k = 0; k < (int) layers.size(); k++)
+        layers[k] = {opt_x[2 * k], opt_x[2 * k + 1]};
 }
 
-bool next_vector(vector<int>& proper_vector)
-{
-    for (int i = proper_vector.size()-1; i >=0; i--)
-        if(proper_vector[i]==-1)
-        {
-            proper_vector[i] = 1;
-            return true;
+template<class Simulator>
+void Hamiltonian::initialize_layers(vector<Parameters>& layers, const Parameters& p, Simulator& simulator) const {
+    //beta has the period 2 pi, the interpolation works with the representative closest to 0
+    layers = {{remainder(p.beta, 2 * M_PI), p.gamma}};
+    while((int) layers.size() < settings().qaoa_depth) {
+        //The layers of depth d are interpolated at d + 1 points, layer i of the new circuit is i/d L_{i-1} + (d-i)/d L_i with L_{-1} = L_d = 0
+        int d = layers.size();
+        vector<Parameters> next(d + 1, {0, 0});
+        for(int i = 0; i <= d; i++) {
+            if(i > 0) {
+                next[i].beta += (double) i / d * layers[i - 1].beta;
+                next[i].gamma += (double) i / d * layers[i - 1].gamma;
+            }
+            if(i < d) {
+                next[i].beta += (double) (d - i) / d * layers[i].beta;
+                next[i].gamma += (double) (d - i) / d * layers[i].gamma;
+            }
         }
-        else
-            proper_vector[i] = -1;
-    return false;
-};
+        layers = next;
+        optimize_layers(layers, simulator);
+    }
+}
 
-void Hamiltonian::solve_by_brute_force() {
+double Hamiltonian::qaoa_mean(const vector<Parameters> &layers) const {
+    if(layers.size() == 1)
+        return qaoa_mean(layers[0]);
+    if(layers.size() == 2 && LightConeEngine::fits(this))
+        return LightConeEngine(this).qaoa_mean(layers);
+    return StateVector(this).qaoa_mean(layers);
+}
 
-    vector<int> best_vector(actual_node_number, -1);
-    vector<int> proper_vector = best_vector;
+Constraint Hamiltonian::find_max_correlation(const vector<Parameters> &layers) const {
+    if(layers.size() == 1)
+        return find_max_correlation(layers[0]);
+    if(layers.size() == 2 && LightConeEngine::fits(this))
+        return LightConeEngine(this).find_max_correlation(layers);
+    return StateVector(this).find_max_correlation(layers);
+}
 
-    vector<int> node_id(active_nodes.begin(), active_nodes.end());
+Constraint Hamiltonian::find_max_correlation(const Parameters &p) const {
+    CorrelationCache cache(this);
+    return cache.find_max_correlation(p);
+}
 
-    // TODO throw an exception if the size is too large
-    CTYPE min_val = INT_MAX;
-    do
-    {
-        CTYPE value = 0;
-        for(int i = 0; i < actual_node_number; i++) {
-            value += linear[node_id[i]] * proper_vector[i];
-            for(int j = i+1; j < actual_node_number; j++)
-                value += quadratic[node_id[i] * allocated + node_id[j]] * proper_vector[i] * proper_vector[j];
-        }
-        if(value < min_val) {
-            min_val = value;
-            best_vector = proper_vector;
+namespace {
+    //Best assignment found by a brute-force search, bit i of code is set if the variable of index i takes the value +1
+    using BruteForceResult = struct BruteForceResult {
+        long long value;
+        uint64_t code;
+    };
+
+    //Keep the smaller energy, ties are broken by the smaller code so that the result doesn't depend on the number of threads
+    void update_result(BruteForceResult& best, long long value, uint64_t code) {
+        if(value < best.value || (value == best.value && code < best.code))
+            best = {value, code};
+    }
+}
+
+void Hamiltonian::solve_by_brute_force() {
+    int n = actual_node_number;
+    if(n > BF_MAX_LIMIT)
+        throw range_error("Too many variables for the brute-force search: " + to_string(n) + " > " + to_string(BF_MAX_LIMIT));
+
+    //The variables with the most interactions take the low bits, that are enumerated by whole blocks,
+    //the other variables are flipped one at a time in Gray code order
+    vector<N_ID> node_id(active_nodes.begin(), active_nodes.end());
+    stable_sort(node_id.begin(), node_id.end(), [this](N_ID a, N_ID b) {
+        return interactions[a].nodes.size() > interactions[b].nodes.size();
+    });
+    vector<int> index(allocated, -1);
+    for(int i = 0; i < n; i++)
+        index[node_id[i]] = i;
+
+    //Interactions of the remaining variables by index
+    vector<int> offsets(n + 1, 0);
+    vector<int> neighbors;
+    vector<CTYPE> coefficients;
+    for(int i = 0; i < n; i++) {
+        const auto& row = interactions[node_id[i]];
+        for(int k = 0; k < (int) row.nodes.size(); k++) {
+            neighbors.push_back(index[row.nodes[k]]);
+            coefficients.push_back(row.coefficients[k]);
         }
+        offsets[i + 1] = neighbors.size();
     }
-    while(next_vector(proper_vector));
 
-    for(int i = 0; i < actual_node_number; i++)
-        constraints.push_back({best_vector[i], node_id[i], -1});
+    int low_bits = min(n, BF_BLOCK_BITS);
+    int high_bits = n - low_bits;
+    size_t block = (size_t) 1 << low_bits;
+    auto spin = [](uint64_t code, int i) { return ((code >> i) & 1) ? 1 : -1; };
+
+    //Energy of the interactions among the low variables for every assignment of the block
+    vector<long long> block_energy(block, 0);
+    for(size_t y = 0; y < block; y++)
+        for(int i = 0; i < low_bits; i++)
+            for(int k = offsets[i]; k < offsets[i + 1]; k++)
+                if(neighbors[k] > i && neighbors[k] < low_bits)
+                    block_energy[y] += (long long) coefficients[k] * spin(y, i) * spin(y, neighbors[k]);
+
+    //Search the assignments of the high variables of Gray code rank in [first, last)
+    auto search = [&](uint64_t first, uint64_t last) {
+        uint64_t gray = first ^ (first >> 1);
+
+        //x[i] is the value of the high variable i, field[i] = h_i + sum_{j high} J_ij x_j
+        vector<int> x(n, 0);
+        vector<long long> field(n);
+        for(int i = 0; i < n; i++)
+            field[i] = linear[node_id[i]];
+        for(int i = low_bits; i < n; i++)
+            x[i] = spin(gray, i - low_bits);
+        long long high_energy = 0;
+        for(int i = low_bits; i < n; i++) {
+            high_energy += field[i] * x[i];
+            for(int k = offsets[i]; k < offsets[i + 1]; k++)
+                if(neighbors[k] >= low_bits && neighbors[k] > i)
+                    high_energy += (long long) coefficients[k] * x[i] * x[neighbors[k]];
+        }
+        for(int i = low_bits; i < n; i++)
+            for(int k = offsets[i]; k < offsets[i + 1]; k++)
+                field[neighbors[k]] += (long long) coefficients[k] * x[i];
+
+        BruteForceResult best = {LLONG_MAX, 0};
+        vector<long long> energy(block);
+        long long* e = energy.data();
+        const long long* quadratic = block_energy.data();
+        for(uint64_t rank = first; ; ) {
+            //Linear energy of the low variables for every assignment of the block, the table is doubled one bit at a time
+            e[0] = 0;
+            for(int i = 0; i < low_bits; i++)
+                e[0] -= field[i];
+            for(int i = 0; i < low_bits; i++) {
+                size_t half = (size_t) 1 << i;
+                long long step = 2 * field[i];
+#pragma omp simd
+                for(size_t y = 0; y < half; y++)
+                    e[y + half] = e[y] + step;
+            }
+            long long block_min = LLONG_MAX;
+#pragma omp simd reduction(min:block_min)
+            for(size_t y = 0; y < block; y++) {
+                e[y] += quadratic[y];
+                block_min = e[y] < block_min ? e[y] : block_min;
+            }
+            if(high_energy + block_min <= best.value) {
+                size_t y = find(e, e + block, block_min) - e;
+                update_result(best, high_energy + block_min, (gray << low_bits) | y);
+            }
+
+            if(++rank == last)
+                break;
+            //The next assignment in Gray code order differs in one variable, flipping it changes the energy by -2 x_i field_i
+            int i = low_bits + __builtin_ctzll(rank);
+            high_energy -= 2 * x[i] * field[i];
+            x[i] = -x[i];
+            gray ^= (uint64_t) 1 << (i - low_bits);
+            for(int k = offsets[i]; k < offsets[i + 1]; k++)
+                field[neighbors[k]] += 2LL * coefficients[k] * x[i];
+        }
+        return best;
+    };
+
+    //The ranks of the high assignments are split in chunks searched in parallel
+    uint64_t prefixes = (uint64_t) 1 << high_bits;
+    int64_t chunks = (int64_t) min<uint64_t>(prefixes, (uint64_t) BF_CHUNKS_PER_THREAD * settings().threads);
+    vector<BruteForceResult> results(chunks);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(settings().threads)
+    for(int64_t c = 0; c < chunks; c++)
+        results[c] = search(prefixes * c / chunks, prefixes * (c + 1) / chunks);
+
+    BruteForceResult best = {LLONG_MAX, 0};
+    for(const auto& r: results)
+        update_result(best, r.value, r.code);
+
+    for(int i = 0; i < n; i++)
+        constraints.push_back({spin(best.code, i), node_id[i], -1});
     active_nodes.clear();
-    return;
 }
 
 
 vector<int> Hamiltonian::rqaoa() {
     bool params_are_initialized = false;
+
+    //The multistart search is randomized, runs with the same seed are reproducible
+    nlopt::srand(settings().seed);
     Parameters p;
 
     //Eliminate nodes until the problem becomes sufficiently small for the brute-force method
-    while (actual_node_number > BF_LIMIT){
-        update_common_neighbors();
+    //Between steps only the correlations around the eliminated node are recomputed
+    CorrelationCache correlations(this);
+    vector<Parameters> layers;
+    unique_ptr<LightConeEngine> light_cones;
+    while (actual_node_number > settings().bf_limit){
+        //Near the end deeper circuits are simulated exactly, the layers of a step are the initial point of the next one
+        if(settings().qaoa_depth > 1 && actual_node_number <= settings().statevector_limit) {
+            if(layers.empty())
+                optimize_parameters(p, params_are_initialized);
+            StateVector state(this);
+            if(layers.empty())
+                initialize_layers(layers, p, state);
+            else
+                optimize_layers(layers, state);
+            add_constraint(state.find_max_correlation(layers));
+            continue;
+        }
+
         optimize_parameters(p, params_are_initialized);
-        Constraint c = find_max_correlation(p);
-        //       cout << c.sigma << " " << c.v << " " << c.u;
-        add_constraint(c);
+
+        //In the batch mode several constraints with disjoint light cones are added for one optimization of the parameters,
+        //at most a fraction of the variables left above the brute-force limit
+        int k = min(settings().rqaoa_batch, max(1, (actual_node_number - settings().bf_limit) / RQAOA_BATCH_SHRINK));
+
+        //QAOA_2 on sparse problems is evaluated from the light cones of the terms, the cones are kept across the steps.
+        //The step uses QAOA_1 if a cone is too large or if the QAOA_2 state doesn't have a lower energy than the QAOA_1 state
+        if(settings().qaoa_depth == 2 && LightConeEngine::fits(this)) {
+            if(!light_cones)
+                light_cones = make_unique<LightConeEngine>(this);
+            else
+                light_cones->update();
+            double qaoa1_energy = qaoa_mean(p);
+            if(layers.empty())
+                initialize_layers(layers, p, *light_cones);
+            else {
+                optimize_layers(layers, *light_cones);
+                //The layers of the previous steps can be stuck in a worse optimum, they are built again from QAOA_1
+                if(light_cones->qaoa_mean(layers) >= qaoa1_energy)
+                    initialize_layers(layers, p, *light_cones);
+            }
+            if(light_cones->qaoa_mean(layers) < qaoa1_energy) {
+                for(const auto& c: light_cones->find_max_correlations(layers, k)) {
+                    correlations.invalidate(c);
+                    add_constraint(c);
+                }
+                continue;
+            }
+        }
+
+        for(const auto& c: correlations.find_max_correlations(p, k)) {
+            //       cout << c.sigma << " " << c.v << " " << c.u;
+            correlations.invalidate(c);
+            add_constraint(c);
+        }
     }
     //Solve the small problem with brute-force groundstate search
     solve_by_brute_force();
@@ -292,26 +706,18 @@ vector<int> Hamiltonian::rqaoa() {
  * @param node_id stores the association between variables in hamiltonian and nodes in the graph
  * @return
  */
-Hamiltonian get_MWIS_Hamiltonian(const Graph& graph, vector<int>& node_id)
+Hamiltonian get_MWIS_Hamiltonian(const CSRGraph& graph, vector<int>& node_id)
 {
-    //Recover active nodes
-    N_CONTAINER active_in_graph = graph.get_active_nodes();
-
-    //Remove the nodes of zero weight from consideration
-    auto it = active_in_graph.begin();
-    while(it != active_in_graph.end())
-    {
-        if (abs(graph.get_node_weight(*it)) < EPSILON)
-            it = active_in_graph.erase(it);
-        else
-            it++;
-    }
-
-    int n_vars = active_in_graph.size(); // Number of variables in the Hamiltonian
-
-    //Associate to each active node of non-zero weight a variable index in the Hamiltonian
+    //Associate to each active node of non-zero weight a variable index in the Hamiltonian, nodes of zero weight are removed from consideration
+    node_id.clear();
+    vector<int> var_id(graph.get_node_number(), -1);
+    for(const auto& u: graph.get_active_nodes())
+        if (abs(graph.get_node_weight(u)) >= EPSILON) {
+            var_id[u] = node_id.size();
+            node_id.push_back(u);
+        }
 
-    node_id = vector<int>(active_in_graph.begin(), active_in_graph.end());
+    int n_vars = node_id.size(); // Number of variables in the Hamiltonian
     Hamiltonian h(n_vars);
 
     //Penalty
@@ -326,14 +732,24 @@ Hamiltonian get_MWIS_Hamiltonian(const Graph& graph, vector<int>& node_id)
 
     lambda *= scale;
 
+    //For dense graphs the number of neighbors that are variables is counted with word-parallel operations
+    vector<BITWORD> is_variable;
+    if(graph.is_dense()) {
+        is_variable.resize(graph.get_row_words(), 0);
+        for(const auto& u: node_id)
+            is_variable[u / WORD_BITS] |= BITWORD(1) << (u % WORD_BITS);
+    }
+
     vector<CTYPE> integer_weights;
-    for(const auto& u: active_in_graph) {
+    for(const auto& u: node_id) {
         //Minus sign as we transform maximization to minimization
         WTYPE scaled_coeff = -round(2 * scale * graph.get_node_weight(u));
-        for(const auto& v: active_in_graph){
-            if(graph.has_edge(u, v))
-                scaled_coeff += lambda;
-        }
+        if(graph.is_dense())
+            scaled_coeff += lambda * (CTYPE) bits_intersection_count(graph.get_adjacency_row(u), is_variable.data(), graph.get_row_words());
+        else
+            for(const auto& v: graph.get_neighbors(u))
+                if(var_id[v] != -1)
+                    scaled_coeff += lambda;
         integer_weights.push_back(scaled_coeff);
     }
 
@@ -350,9 +766,10 @@ Hamiltonian get_MWIS_Hamiltonian(const Graph& graph, vector<int>& node_id)
     h.set_linear(i, integer_weights[i]);
 
     for(int i = 0; i < n_vars; i++)
-        for(int j = i+1; j < n_vars; j++)
+        for(const auto& v: graph.get_neighbors(node_id[i]))
         {
-            if (graph.has_edge(node_id[i], node_id[j]))
+            int j = var_id[v];
+            if (j > i)
                 h.set_quadratic(i, j, lambda);
         }
 
@@ -361,6 +778,11 @@ Hamiltonian get_MWIS_Hamiltonian(const Graph& graph, vector<int>& node_id)
 
 
 bool quantumMWIS(const Graph& graph, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff)
+{
+    return quantumMWIS(CSRGraph(graph), IS, IS_weight, cutoff);
+}
+
+bool quantumMWIS(const CSRGraph& graph, N_CONTAINER& IS, WTYPE& IS_weight, const WTYPE& cutoff)
 {
     //Initialize the problem
     vector<int> node_id;
@@ -392,5 +814,5 @@ bool quantumMWIS(const Graph& graph, N_CONTAINER& IS, WTYPE& IS_weight, const WT
         IS_weight = rqaoa_weight;
         IS = rqaoa_is;
     }
-    return IS_weight > cutoff;
+    return improve_with_ils(graph, IS, IS_weight, cutoff, settings().ils_post_time);
 }
@@ -7,11 +7,16 @@
 
 #include "../Graph.h"
 #include "../mwis/mwis.h"
+#include "TrigTable.h"
 #include <list>
 
-// Threshold for the brute-force solution
+// The brute-force search enumerates the assignments of the BF_BLOCK_BITS most connected variables as one block
 
-#define BF_LIMIT 12
+#define BF_BLOCK_BITS 10
+
+// In the batch mode of RQAOA at most 1/RQAOA_BATCH_SHRINK of the variables above settings().bf_limit are eliminated per step
+
+#define RQAOA_BATCH_SHRINK 10
 
 using CTYPE = int;
 
@@ -48,7 +53,23 @@ using Constraint = struct Constraint{
     N_ID v;
 };
 
+/** Interaction terms of a variable in the Ising Hamiltonian
+ *
+ * The other variables are sorted by id, coefficients[i] is the coefficient J of the term with nodes[i].
+ */
+using InteractionRow = struct InteractionRow{
+    vector<N_ID> nodes;
+    vector<CTYPE> coefficients;
+};
+
+class CorrelationCache;
+class StateVector;
+class LightConeEngine;
+
 class Hamiltonian {
+    friend class CorrelationCache;
+    friend class StateVector;
+    friend class LightConeEngine;
 
     //Inital size of the instance (before RQAOA)
     int allocated;
@@ -62,25 +83,29 @@ class Hamiltonian {
     //Constraints added by RQAOA
     list<Constraint> constraints;
 
-    //For each active node stores a list of other nodes connected by a non-zero interaction term J_i,j in the Ising Hamiltonian
-    vector<N_CONTAINER> neighbors;
-
-    //Service structure - for each pair of active nodes stores the union of their neighbors, accelerate the computation of mean values.
-    vector<vector<N_CONTAINER>> common_neighbors;
+    //For each active node stores the other active nodes connected by a non-zero interaction term J_i,j in the Ising Hamiltonian
+    vector<InteractionRow> interactions;
 
     //Linear coefficients of the Ising model
     vector<CTYPE> linear;
 
-    //Quadratic coefficients of the Ising model
-    vector<CTYPE> quadratic;
+    /** Set the coefficient of v in the row, the entry is removed if the coefficient is zero
+     *
+     */
+    static void set_interaction(InteractionRow& row, const N_ID& v, CTYPE weight);
 
-    /** After a variable is removed and the instance is modified - updates the list of common neighbors
+    /** Bound on the absolute value of the integer multiples of gamma appearing in the mean values
      *
      */
-    void update_common_neighbors();
+    int coefficient_bound() const;
+
+    //Mean values with the cosines and sines read from a table built for p.gamma and coefficient_bound()
+    //If gradient is not null, the partial derivatives with respect to beta and gamma are added to gradient[0] and gradient[1]
+    double z_mean(const N_ID& u, const Parameters& p, const TrigTable& trig, double* gradient = nullptr) const;
+    double zz_mean(const N_ID& u, const N_ID& v, const Parameters& p, const TrigTable& trig, double* gradient = nullptr) const;
 
 public:
-    Hamiltonian(int n): linear(n, 0), quadratic(n*n, 0), actual_node_number(n), allocated(n), neighbors(n), common_neighbors(n, vector<N_CONTAINER>(n)) {
+    Hamiltonian(int n): allocated(n), actual_node_number(n), interactions(n), linear(n, 0) {
         for(int i = 0; i < n; i++)
             active_nodes.insert(i);
     };
@@ -103,9 +128,21 @@ public:
     /** Compute the mean energy of the Hamiltonian at the point p the with an analytical function
      *
      * @param p
+     * @param gradient if not null, stores the partial derivatives of the energy with respect to beta and gamma, computed in the same pass
      * @return the mean energy in QAOA_1(p.beta, p.gamma) state
      */
-    double qaoa_mean(const Parameters& p) const;
+    double qaoa_mean(const Parameters& p, double* gradient = nullptr) const;
+
+    /** Compute the mean energy of the Hamiltonian in the QAOA state with one layer per element of layers
+     *
+     * One layer uses the analytical function, two layers the light cones of the terms if they are small enough
+     * (see LightConeEngine), otherwise the state vector is simulated.
+     *
+     * @param layers
+     * @return the mean energy
+     * @throw range_error if the circuit can't be evaluated with any of the methods
+     */
+    double qaoa_mean(const vector<Parameters>& layers) const;
 
     /** Modifies the linear coefficient of the node u
      *
@@ -122,10 +159,21 @@ public:
      */
     void set_quadratic(const N_ID& u, const N_ID& v, CTYPE weight);
 
+    /** Get the quadratic coefficient of the term Z_uZ_v
+     *
+     * @param u
+     * @param v
+     * @return J_u,v, zero if there is no such term
+     * @note Takes O(log min(deg u, deg v))
+     */
+    CTYPE get_quadratic(const N_ID& u, const N_ID& v) const;
+
 
     void remove_node(const N_ID&  u);
 
     /** Add a constraint, modify the Hamiltonian, and remove a variable
+     *
+     * Only the rows of c.u, c.v and of the neighbors of c.u are touched, the cost is O(deg c.u + deg c.v + sum of deg w over the neighbors w of c.u).
      *
      * @param c
      */
@@ -135,21 +183,69 @@ public:
      *
      * @param p
      * @param in_neighborhood True if we search for an optimum in the neighborhood of p
-     * @throw TODO an exception when the optimizer fails (see nlopt::opt::optimize)
-     * @note If the initial point is not provided finds it with a multistart global search. Then use BOBYQA method for the local search
+     * @throw runtime_error, invalid_argument or bad_alloc if NLopt fails (see nlopt::opt::optimize), a search stopped by roundoff
+     * errors keeps the best point found
+     * @note If the initial point is not provided finds it with a multistart global search. The local search uses the method given by
+     * settings().qaoa_optimizer: L-BFGS or MMA with the analytic gradient, or the derivative-free BOBYQA
      */
     void optimize_parameters(Parameters& p, bool& in_neighborhood) const;
 
-    Constraint find_max_correlation(const Parameters& p);
+    /** Optimize the layers of the QAOA circuit with the derivative-free local search BOBYQA
+     *
+     * @param layers the initial point, modified
+     * @param simulator a StateVector or a LightConeEngine of the Hamiltonian, evaluates the energy of the layers
+     */
+    template<class Simulator>
+    void optimize_layers(vector<Parameters>& layers, Simulator& simulator) const;
+
+    /** Find the layers of a circuit of depth settings().qaoa_depth from the optimal parameters of QAOA_1
+     *
+     * The depth grows by one layer at a time, the optimal layers are linearly interpolated to one more layer and optimized again.
+     *
+     * @param layers output
+     * @param p optimal parameters of QAOA_1
+     * @param simulator a StateVector or a LightConeEngine of the Hamiltonian
+     * @note the interpolation is the INTERP strategy of the paper [Quantum Approximate Optimization Algorithm: Performance, Mechanism,
+     * and Implementation on Near-Term Devices] by L. Zhou, S.-T. Wang, S. Choi, H. Pichler, M. D. Lukin
+     */
+    template<class Simulator>
+    void initialize_layers(vector<Parameters>& layers, const Parameters& p, Simulator& simulator) const;
+
+    /** Find the variable or the pair of variables with the largest absolute correlation in the QAOA_1 state
+     *
+     * Pairs at distance at most 2 in the interaction graph are enumerated, for the other pairs <Z_uZ_v> = <Z_u><Z_v> and the
+     * best one is read from the nodes sorted by |<Z_u>|. The cost is about the number of paths of length 2, not the number of pairs.
+     * RQAOA keeps the correlations between steps in a CorrelationCache instead.
+     *
+     * @param p
+     * @return the constraint fixing the sign of the most correlated term, ties are broken by the smallest (u, v)
+     */
+    Constraint find_max_correlation(const Parameters& p) const;
+
+    /** Find the variable or the pair of variables with the largest absolute correlation in the QAOA state with the given layers
+     *
+     * The methods are chosen as in qaoa_mean(layers), with the light cones only the terms of the Hamiltonian are candidates.
+     *
+     * @param layers
+     * @return the constraint fixing the sign of the most correlated term, ties are broken by the smallest (u, v)
+     * @throw range_error if the circuit can't be evaluated with any of the methods
+     */
+    Constraint find_max_correlation(const vector<Parameters>& layers) const;
 
     /** Compute the exact ground state of the Hamiltonian with a brute-force approach
      *
-     * If the number of active nodes is larger than BF_limit throw an exception
-     * @throw TODO if the instance is too large
+     * The assignments are enumerated in Gray code order with O(deg) energy updates, in blocks of 2^BF_BLOCK_BITS assignments
+     * of the most connected variables, the search is split among settings().threads threads.
+     * @throw range_error if the number of active nodes is larger than BF_MAX_LIMIT
      */
     void solve_by_brute_force();
 
     /** Compute the approximate ground state of the Hamiltonian with RQAOA
+     *
+     * With settings().qaoa_depth > 1, once at most settings().statevector_limit variables are left the correlations are read from the
+     * state vector of a circuit with qaoa_depth layers, one variable is eliminated per step. With qaoa_depth = 2 the larger
+     * sparse problems are evaluated from the light cones of the terms while they fit in LIGHTCONE_MAX_INNER variables.
+     * With settings().rqaoa_batch > 1, each optimization of the parameters is followed by up to rqaoa_batch eliminations of terms with disjoint light cones.
      *
      * @return an approximate solution x \in {-1, 1}^n
      * @note the algorithm was introduced in the paper [Obstacles to State Preparation and Variational Optimization from Symmetry Protection] by S/ Bravyi, A. Kliesch, R. Koenig, E. Tang
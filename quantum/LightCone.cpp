@@ -0,0 +1,494 @@
+//
+// Created on 17/10/26.
+//
+
+#include "LightCone.h"
+#include "StateVector.h"
+#include <numeric>
+#include <algorithm>
+
+namespace {
+
+int spin(int64_t x, int i) {
+    return ((x >> i) & 1) ? 1 : -1;
+}
+
+uint64_t mix(uint64_t hash, uint64_t value) {
+    return hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2));
+}
+
+//Hash of a multiset of values
+uint64_t hash_multiset(vector<uint64_t>& values) {
+    sort(values.begin(), values.end());
+    uint64_t hash = values.size();
+    for(const auto& value: values)
+        hash = mix(hash, value);
+    return hash;
+}
+
+/** Apply exp(-i beta/2 X) to the rows and exp(i beta/2 X) to the columns of a density matrix of 2^qubits x 2^qubits entries,
+ * the entry (x, y) is at the index x + (y << qubits)
+ *
+ */
+void apply_mixer(vector<double>& re, vector<double>& im, int qubits, double beta) {
+    double c = cos(beta / 2), s = sin(beta / 2);
+    int64_t size = re.size();
+    for(int q = 0; q < 2 * qubits; q++) {
+        int64_t stride = (int64_t) 1 << q;
+        for(int64_t a = 0; a < size; a += 2 * stride)
+            butterfly(re.data() + a, im.data() + a, stride, stride, c, q < qubits ? s : -s);
+    }
+}
+
+} // namespace
+
+LightCone::LightCone(int term_size, const vector<CTYPE> &linear, const vector<tuple<int, int, CTYPE>> &edges,
+                     const vector<vector<pair<int, CTYPE>>> &outer): inner(linear.size()), term_size(term_size), single(linear.size()) {
+    int64_t size = (int64_t) 1 << inner;
+    first_energy.resize(size);
+    second_energy.resize(size);
+    long long max_first = 0, max_second = 0, max_field = 0;
+    for(int64_t x = 0; x < size; x++) {
+        long long first = 0, second = 0;
+        for(int i = 0; i < inner; i++) {
+            first += linear[i] * spin(x, i);
+            if(i < term_size)
+                second += linear[i] * spin(x, i);
+        }
+        for(const auto& [i, j, J]: edges) {
+            first += J * spin(x, i) * spin(x, j);
+            if(i < term_size || j < term_size)
+                second += J * spin(x, i) * spin(x, j);
+        }
+        first_energy[x] = first;
+        second_energy[x] = second;
+        max_first = max(max_first, abs(first));
+        max_second = max(max_second, abs(second));
+    }
+    for(const auto& couplings: outer) {
+        if(couplings.size() == 1) {
+            single[couplings[0].first].push_back(couplings[0].second);
+            max_field = max(max_field, (long long) abs(couplings[0].second));
+            continue;
+        }
+        vector<CTYPE> field(size, 0);
+        for(int64_t x = 0; x < size; x++) {
+            for(const auto& [i, J]: couplings)
+                field[x] += J * spin(x, i);
+            max_field = max(max_field, (long long) abs(field[x]));
+        }
+        fields.push_back(std::move(field));
+    }
+    //The dephasing factors are cos(gamma_1 / 2 * (f(x) - f(y)))
+    first_bound = max(max_first, 2 * max_field);
+    second_bound = 2 * max_second;
+}
+
+double LightCone::mean(const Parameters &first, const Parameters &second) const {
+    int64_t size = (int64_t) 1 << inner;
+    TrigTable trig(first.gamma / 2, first_bound);
+
+    //Amplitudes of the inner variables after the phase of the first layer
+    vector<double> phase_re(size), phase_im(size);
+    for(int64_t x = 0; x < size; x++) {
+        phase_re[x] = trig.cos(first_energy[x]);
+        phase_im[x] = -trig.sin(first_energy[x]);
+    }
+    //An outer variable with a single coupling J to the inner variable i multiplies the entries with x_i != y_i by cos(gamma_1 J),
+    //dephasing[z] is the product of these factors over the bits of z = x ^ y, with the normalization of |+>
+    vector<double> dephasing(size);
+    dephasing[0] = 1.0 / size;
+    for(int i = 0; i < inner; i++) {
+        double c = 1;
+        for(const auto& J: single[i])
+            c *= trig.cos(2 * J);
+        int64_t half = (int64_t) 1 << i;
+        for(int64_t z = 0; z < half; z++)
+            dephasing[z + half] = dephasing[z] * c;
+    }
+
+    vector<double> re(size * size), im(size * size);
+    vector<double> row(size);
+    for(int64_t y = 0; y < size; y++) {
+        for(int64_t x = 0; x < size; x++)
+            row[x] = dephasing[x ^ y];
+        for(const auto& field: fields)
+            for(int64_t x = 0; x < size; x++)
+                row[x] *= trig.cos(field[x] - field[y]);
+        double* r = re.data() + (y << inner);
+        double* m = im.data() + (y << inner);
+        for(int64_t x = 0; x < size; x++) {
+            r[x] = (phase_re[x] * phase_re[y] + phase_im[x] * phase_im[y]) * row[x];
+            m[x] = (phase_im[x] * phase_re[y] - phase_re[x] * phase_im[y]) * row[x];
+        }
+    }
+    //After the mixer of the first layer only the entries with x_w = y_w on the inner variables w outside the term are used.
+    //The variables are processed from the last one, its column bit is the top bit of the index: after its mixer the rows
+    //and the columns with x_w = y_w are kept and the matrix is halved.
+    double c = cos(first.beta / 2), s = sin(first.beta / 2);
+    int64_t entries = size * size;
+    double* r = re.data();
+    double* m = im.data();
+    for(int w = inner - 1; w >= term_size; w--) {
+        int64_t stride = (int64_t) 1 << w;
+        for(int64_t a = 0; a < entries; a += 2 * stride)
+            butterfly(r + a, m + a, stride, stride, c, s);
+        int64_t half = entries / 2;
+        for(int64_t a = 0; a < half; a += 2 * stride) {
+            //Column mixer exp(i beta/2 X), the entries with x_w = 0 keep the column y_w = 0
+#pragma omp simd
+            for(int64_t j = a; j < a + stride; j++) {
+                double x = r[j], y = m[j], u = r[j + half], v = m[j + half];
+                r[j] = c * x - s * v;
+                m[j] = c * y + s * u;
+            }
+#pragma omp simd
+            for(int64_t j = a + stride; j < a + 2 * stride; j++) {
+                double x = r[j], y = m[j], u = r[j + half], v = m[j + half];
+                r[j] = c * u - s * y;
+                m[j] = c * v + s * x;
+            }
+        }
+        entries = half;
+    }
+    //The index is now x + (b << inner) with b the column bits of the term
+    for(int q = 0; q < term_size; q++) {
+        int64_t stride = (int64_t) 1 << q;
+        for(int64_t a = 0; a < entries; a += 2 * stride)
+            butterfly(r + a, m + a, stride, stride, c, s);
+        stride = (int64_t) 1 << (inner + q);
+        for(int64_t a = 0; a < entries; a += 2 * stride)
+            butterfly(r + a, m + a, stride, stride, c, -s);
+    }
+
+    //The phase of the second layer and the trace over the inner variables outside the term
+    TrigTable second_trig(second.gamma / 2, second_bound);
+    int64_t term_states = (int64_t) 1 << term_size;
+    vector<double> reduced_re(term_states * term_states, 0), reduced_im(term_states * term_states, 0);
+    for(int64_t j = 0; j < entries; j++) {
+        int64_t x = j & (size - 1);
+        int64_t a = x & (term_states - 1), b = j >> inner;
+        CTYPE k = second_energy[x] - second_energy[(x & ~(term_states - 1)) | b];
+        double cos_k = second_trig.cos(k), sin_k = second_trig.sin(k);
+        reduced_re[a + (b << term_size)] += r[j] * cos_k + m[j] * sin_k;
+        reduced_im[a + (b << term_size)] += m[j] * cos_k - r[j] * sin_k;
+    }
+    apply_mixer(reduced_re, reduced_im, term_size, second.beta);
+
+    double mean = 0;
+    for(int64_t a = 0; a < term_states; a++) {
+        int sign = 1;
+        for(int i = 0; i < term_size; i++)
+            sign *= spin(a, i);
+        mean += sign * reduced_re[a + (a << term_size)];
+    }
+    return mean;
+}
+
+LightConeEngine::LightConeEngine(const Hamiltonian *h): h(h), pairs_found(false), position(h->allocated, -1) {
+    update();
+}
+
+bool LightConeEngine::fits(const Hamiltonian *h) {
+    for(const auto& u: h->active_nodes) {
+        const auto& row_u = h->interactions[u].nodes;
+        if((int) row_u.size() + 1 > LIGHTCONE_MAX_INNER)
+            return false;
+        for(const auto& v: row_u)
+            if(v > u) {
+                //The inner variables are the union of the rows, the row of u contains v and the row of v contains u
+                const auto& row_v = h->interactions[v].nodes;
+                int common = 0;
+                for(int i = 0, j = 0; i < (int) row_u.size() && j < (int) row_v.size(); ) {
+                    if(row_u[i] == row_v[j]) {
+                        common++;
+                        i++;
+                        j++;
+                    }
+                    else if(row_u[i] < row_v[j])
+                        i++;
+                    else
+                        j++;
+                }
+                if((int) (row_u.size() + row_v.size()) - common > LIGHTCONE_MAX_INNER)
+                    return false;
+            }
+    }
+    return true;
+}
+
+vector<long long> LightConeEngine::canonical_key(N_ID t0, N_ID t1, int &inner, vector<CTYPE> &linear, vector<tuple<int, int, CTYPE>> &edges,
+                                                 vector<vector<pair<int, CTYPE>>> &outer) {
+    //Inner variables: the nodes of the term, then their neighbors
+    vector<N_ID> nodes = {t0};
+    if(t1 != -1)
+        nodes.push_back(t1);
+    int term_size = nodes.size();
+    for(int i = 0; i < term_size; i++)
+        position[nodes[i]] = i;
+    for(int i = 0; i < term_size; i++)
+        for(const auto& x: h->interactions[nodes[i]].nodes)
+            if(position[x] == -1) {
+                position[x] = nodes.size();
+                nodes.push_back(x);
+            }
+    int n = nodes.size();
+
+    //Interactions of the inner variables, an outer variable b is marked in position with -2 - b
+    vector<vector<pair<int, CTYPE>>> inner_adjacency(n), outer_adjacency(n);
+    vector<vector<pair<int, CTYPE>>> patterns;
+    vector<N_ID> outer_nodes;
+    if(n <= LIGHTCONE_MAX_INNER)
+        for(int i = 0; i < n; i++) {
+            const auto& row = h->interactions[nodes[i]];
+            for(int k = 0; k < (int) row.nodes.size(); k++) {
+                N_ID y = row.nodes[k];
+                if(position[y] >= 0) {
+                    inner_adjacency[i].push_back({position[y], row.coefficients[k]});
+                    continue;
+                }
+                if(position[y] == -1) {
+                    position[y] = -2 - (int) patterns.size();
+                    outer_nodes.push_back(y);
+                    patterns.emplace_back();
+                }
+                int b = -2 - position[y];
+                patterns[b].push_back({i, row.coefficients[k]});
+                outer_adjacency[i].push_back({b, row.coefficients[k]});
+            }
+        }
+    for(const auto& x: nodes)
+        position[x] = -1;
+    for(const auto& x: outer_nodes)
+        position[x] = -1;
+    if(n > LIGHTCONE_MAX_INNER)
+        throw range_error("Too many inner variables in a light cone: " + to_string(n) + " > " + to_string(LIGHTCONE_MAX_INNER));
+
+    //Colors of the inner variables refined with the colors of their neighbors, the nodes of the term keep their positions
+    vector<uint64_t> color(n), outer_color(patterns.size());
+    for(int i = 0; i < n; i++)
+        color[i] = mix(mix(0, h->linear[nodes[i]]), i < term_size ? i + 1 : 0);
+    for(int round = 0; round < LIGHTCONE_REFINEMENT_ROUNDS; round++) {
+        vector<uint64_t> items;
+        for(int b = 0; b < (int) patterns.size(); b++) {
+            items.clear();
+            for(const auto& [i, J]: patterns[b])
+                items.push_back(mix(J, color[i]));
+            outer_color[b] = hash_multiset(items);
+        }
+        vector<uint64_t> refined(n);
+        for(int i = 0; i < n; i++) {
+            items.clear();
+            for(const auto& [j, J]: inner_adjacency[i])
+                items.push_back(mix(J, color[j]));
+            uint64_t inner_hash = hash_multiset(items);
+            items.clear();
+            for(const auto& [b, J]: outer_adjacency[i])
+                items.push_back(mix(J, outer_color[b]));
+            refined[i] = mix(mix(color[i], inner_hash), hash_multiset(items));
+        }
+        color = refined;
+    }
+    vector<int> order(n);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin() + term_size, order.end(), [&](int a, int b) {
+        return make_pair(color[a], nodes[a]) < make_pair(color[b], nodes[b]);
+    });
+    vector<int> relabel(n);
+    for(int k = 0; k < n; k++)
+        relabel[order[k]] = k;
+
+    //The relabeled cone, its key lists all its coefficients
+    inner = n;
+    linear.assign(n, 0);
+    for(int i = 0; i < n; i++)
+        linear[relabel[i]] = h->linear[nodes[i]];
+    edges.clear();
+    for(int i = 0; i < n; i++)
+        for(const auto& [j, J]: inner_adjacency[i])
+            if(relabel[i] < relabel[j])
+                edges.emplace_back(relabel[i], relabel[j], J);
+    sort(edges.begin(), edges.end());
+    outer.clear();
+    for(auto& couplings: patterns) {
+        for(auto& [i, J]: couplings)
+            i = relabel[i];
+        sort(couplings.begin(), couplings.end());
+        outer.push_back(std::move(couplings));
+    }
+    sort(outer.begin(), outer.end());
+
+    vector<long long> key = {term_size, n};
+    key.insert(key.end(), linear.begin(), linear.end());
+    key.push_back(edges.size());
+    for(const auto& [i, j, J]: edges)
+        key.insert(key.end(), {i, j, J});
+    key.push_back(outer.size());
+    for(const auto& couplings: outer) {
+        key.push_back(couplings.size());
+        for(const auto& [i, J]: couplings)
+            key.insert(key.end(), {i, J});
+    }
+    return key;
+}
+
+int LightConeEngine::find_cone(N_ID u, N_ID v) {
+    int inner;
+    vector<CTYPE> linear;
+    vector<tuple<int, int, CTYPE>> edges;
+    vector<vector<pair<int, CTYPE>>> outer;
+    auto key = canonical_key(u, v, inner, linear, edges, outer);
+    //Z_uZ_v = Z_vZ_u, the smaller key of the two orders of the nodes is used
+    if(v != -1) {
+        int other_inner;
+        vector<CTYPE> other_linear;
+        vector<tuple<int, int, CTYPE>> other_edges;
+        vector<vector<pair<int, CTYPE>>> other_outer;
+        auto other_key = canonical_key(v, u, other_inner, other_linear, other_edges, other_outer);
+        if(other_key < key) {
+            key = std::move(other_key);
+            linear = std::move(other_linear);
+            edges = std::move(other_edges);
+            outer = std::move(other_outer);
+        }
+    }
+
+    auto it = index.find(key);
+    if(it != index.end())
+        return it->second;
+    cones.emplace_back(v == -1 ? 1 : 2, linear, edges, outer);
+    index.emplace(std::move(key), cones.size() - 1);
+    return cones.size() - 1;
+}
+
+void LightConeEngine::update() {
+    terms.clear();
+    for(const auto& u: h->active_nodes) {
+        terms.push_back({u, -1, h->linear[u], find_cone(u, -1)});
+        const auto& row = h->interactions[u];
+        for(int k = 0; k < (int) row.nodes.size(); k++)
+            if(row.nodes[k] > u)
+                terms.push_back({u, row.nodes[k], row.coefficients[k], find_cone(u, row.nodes[k])});
+    }
+    values.resize(cones.size(), 0);
+    evaluated.resize(cones.size(), 0);
+    pairs.clear();
+    pairs_found = false;
+}
+
+void LightConeEngine::find_pairs() {
+    //close[x] is 1 in the closed neighborhood of u and 2 for the nodes at distance 2 already listed
+    vector<char> close(h->allocated, 0);
+    vector<N_ID> distance_two;
+    for(const auto& u: h->active_nodes) {
+        const auto& row_u = h->interactions[u].nodes;
+        if((int) row_u.size() + 2 > LIGHTCONE_MAX_INNER)
+            continue;
+        close[u] = 1;
+        for(const auto& x: row_u)
+            close[x] = 1;
+        distance_two.clear();
+        for(const auto& x: row_u)
+            for(const auto& w: h->interactions[x].nodes)
+                if(w > u && !close[w]) {
+                    close[w] = 2;
+                    distance_two.push_back(w);
+                }
+        for(const auto& w: distance_two) {
+            //The inner variables are N[u] and the nodes of N[w] outside of it
+            int inner = row_u.size() + 2;
+            for(const auto& y: h->interactions[w].nodes)
+                inner += close[y] != 1;
+            if(inner <= LIGHTCONE_MAX_INNER)
+                pairs.push_back({u, w, 0, find_cone(u, w)});
+        }
+        close[u] = 0;
+        for(const auto& x: row_u)
+            close[x] = 0;
+        for(const auto& w: distance_two)
+            close[w] = 0;
+    }
+    values.resize(cones.size(), 0);
+    evaluated.resize(cones.size(), 0);
+    pairs_found = true;
+}
+
+void LightConeEngine::evaluate(const vector<Parameters> &layers, const vector<Term> &selected) {
+    if(layers.size() != 2)
+        throw invalid_argument("The light cones are built for QAOA_2, got " + to_string(layers.size()) + " layers");
+    bool same_layers = last_layers.size() == 2;
+    for(int k = 0; same_layers && k < 2; k++)
+        same_layers = last_layers[k].beta == layers[k].beta && last_layers[k].gamma == layers[k].gamma;
+    if(!same_layers) {
+        fill(evaluated.begin(), evaluated.end(), 0);
+        last_layers = layers;
+    }
+
+    //Each cone is simulated once, the cones are independent
+    vector<int> pending;
+    for(const auto& t: selected)
+        if(!evaluated[t.cone]) {
+            evaluated[t.cone] = 1;
+            pending.push_back(t.cone);
+        }
+    int size = pending.size();
+#pragma omp parallel for schedule(dynamic, 1) num_threads(settings().threads)
+    for(int i = 0; i < size; i++)
+        values[pending[i]] = cones[pending[i]].mean(layers[0], layers[1]);
+}
+
+double LightConeEngine::qaoa_mean(const vector<Parameters> &layers) {
+    evaluate(layers, terms);
+    double mean = 0;
+    for(const auto& t: terms)
+        mean += t.coefficient * values[t.cone];
+    return mean;
+}
+
+vector<Correlation> LightConeEngine::correlations(const vector<Parameters> &layers) {
+    if(!pairs_found)
+        find_pairs();
+    evaluate(layers, terms);
+    evaluate(layers, pairs);
+    vector<Correlation> candidates;
+    candidates.reserve(terms.size() + pairs.size());
+    for(const auto& t: terms)
+        candidates.push_back(make_correlation(values[t.cone], t.u, t.v));
+    for(const auto& t: pairs)
+        candidates.push_back(make_correlation(values[t.cone], t.u, t.v));
+    return candidates;
+}
+
+Constraint LightConeEngine::find_max_correlation(const vector<Parameters> &layers) {
+    Correlation output = {0, {1, *h->active_nodes.begin(), -1}};
+    for(const auto& candidate: correlations(layers))
+        if(candidate.better_than(output))
+            output = candidate;
+    return output.constraint;
+}
+
+vector<Constraint> LightConeEngine::find_max_correlations(const vector<Parameters> &layers, int k) {
+    vector<Correlation> candidates = correlations(layers);
+    sort(candidates.begin(), candidates.end(), [](const Correlation& a, const Correlation& b) { return a.better_than(b); });
+
+    vector<Constraint> output = {find_max_correlation(layers)};
+    vector<char> used(h->allocated, 0);
+    auto inner_variables = [&](const Constraint& c) {
+        vector<N_ID> nodes = h->interactions[c.u].nodes;
+        nodes.push_back(c.u);
+        if(c.v != -1)
+            nodes.insert(nodes.end(), h->interactions[c.v].nodes.begin(), h->interactions[c.v].nodes.end());
+        return nodes;
+    };
+    for(const auto& u: inner_variables(output[0]))
+        used[u] = 1;
+    for(int i = 0; i < (int) candidates.size() && (int) output.size() < k && candidates[i].value > 0; i++) {
+        auto nodes = inner_variables(candidates[i].constraint);
+        if(any_of(nodes.begin(), nodes.end(), [&](N_ID u) { return used[u]; }))
+            continue;
+        for(const auto& u: nodes)
+            used[u] = 1;
+        output.push_back(candidates[i].constraint);
+    }
+    return output;
+}
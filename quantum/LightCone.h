@@ -0,0 +1,163 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_LIGHTCONE_H
+#define QUANTUM_BNP_LIGHTCONE_H
+
+#include <map>
+#include "Hamiltonian.h"
+#include "CorrelationCache.h"
+
+//Terms whose light cone has more than LIGHTCONE_MAX_INNER inner variables are not simulated, the density matrix has 4^inner entries.
+//A cone of 8 inner variables takes about 1 ms per evaluation and a cone of 10 about 30 ms, a 5-regular graph has a hundred cones of 10
+#define LIGHTCONE_MAX_INNER 8
+
+//Rounds of color refinement used to order the inner variables of a light cone
+#define LIGHTCONE_REFINEMENT_ROUNDS 3
+
+/** The light cone of a term Z_u or Z_uZ_v of the Hamiltonian in the QAOA_2 circuit, up to a relabeling of the variables
+ *
+ * The inner variables are the nodes of the term and their neighbors, the variables 0 (and 1) are the nodes of the term. The outer
+ * variables are the other neighbors of the inner ones. The mean value of the term only depends on the Hamiltonian terms that
+ * touch an inner variable. An outer variable is only acted on by the phase of the first layer before it is traced out, it
+ * multiplies the entry (x, y) of the density matrix of the inner variables by cos(gamma_1 (f(x) - f(y)) / 2) with f the sum of
+ * its couplings J s_i to the inner variables. The density matrix of the inner variables is simulated exactly.
+ */
+class LightCone {
+    int inner;
+    int term_size; // 1 for Z_u, 2 for Z_uZ_v
+    vector<CTYPE> first_energy; // energy of the terms touching an inner variable, for each state of the inner variables
+    vector<CTYPE> second_energy; // energy of the terms touching the nodes of the term
+    vector<vector<CTYPE>> single; // single[i] = couplings of the outer variables connected to the inner variable i only
+    vector<vector<CTYPE>> fields; // f(x) of each outer variable connected to several inner variables
+    int first_bound; // bound on the multiples of gamma_1 / 2 in the first layer
+    int second_bound;
+
+public:
+    /** Build the tables of a canonical light cone
+     *
+     * @param term_size
+     * @param linear linear coefficients of the inner variables
+     * @param edges (i, j, J_ij) for the interactions of the inner variables
+     * @param outer for each outer variable, its couplings (i, J) to the inner variables
+     */
+    LightCone(int term_size, const vector<CTYPE>& linear, const vector<tuple<int, int, CTYPE>>& edges,
+              const vector<vector<pair<int, CTYPE>>>& outer);
+
+    /** Compute the mean value of the term in the QAOA_2 state
+     *
+     * @param first parameters of the first layer
+     * @param second parameters of the second layer
+     */
+    double mean(const Parameters& first, const Parameters& second) const;
+};
+
+/** Evaluation of the QAOA_2 state of a sparse Hamiltonian term by term from the light cones
+ *
+ * For every active node u the term Z_u, and for every interaction the term Z_uZ_v, is mapped to its light cone in canonical form,
+ * isomorphic cones share one LightCone and one evaluation. The cones are ordered by the colors of a refinement of the node labels,
+ * the key of a cone is its whole relabeled structure, so two cones with the same key are identical. Isomorphic cones whose
+ * refinement leaves ties get different keys and are simulated twice. The cones are kept when the Hamiltonian changes.
+ *
+ * The cost of an evaluation is linear in the number of terms plus the simulation of the distinct cones. The pairs at distance 2
+ * without interaction are mapped to cones only when the correlations are searched, the energy never evaluates them.
+ */
+class LightConeEngine {
+    using Term = struct Term {
+        N_ID u;
+        N_ID v; // -1 for Z_u
+        CTYPE coefficient;
+        int cone;
+    };
+
+    const Hamiltonian* h;
+    vector<Term> terms;
+    vector<Term> pairs; // Z_uZ_w for the pairs at distance 2 without interaction whose cone fits, only candidates of the correlations
+    bool pairs_found; // true if pairs matches the current Hamiltonian
+    map<vector<long long>, int> index; // canonical key -> cone
+    vector<LightCone> cones;
+    vector<double> values; // mean value of each cone at the layers of the last evaluation, valid if evaluated[c]
+    vector<char> evaluated;
+    vector<Parameters> last_layers;
+    vector<int> position; // position of a node among the inner variables of the cone being built, -1 otherwise
+
+    /** Find the cone of the term Z_{t0} or Z_{t0}Z_{t1} with the nodes of the term in this order, and its canonical key
+     *
+     */
+    vector<long long> canonical_key(N_ID t0, N_ID t1, int& inner, vector<CTYPE>& linear, vector<tuple<int, int, CTYPE>>& edges,
+                                    vector<vector<pair<int, CTYPE>>>& outer);
+
+    /** Find or create the cone of a term
+     *
+     */
+    int find_cone(N_ID u, N_ID v);
+
+    /** Compute the mean values of the cones of the selected terms for the given layers
+     *
+     */
+    void evaluate(const vector<Parameters>& layers, const vector<Term>& selected);
+
+    /** Map the pairs at distance 2 without interaction to their cones, the pairs with more than LIGHTCONE_MAX_INNER inner
+     * variables are skipped
+     *
+     */
+    void find_pairs();
+
+    /** The correlations of the terms and of the pairs at distance 2 in the QAOA_2 state with the given layers
+     *
+     */
+    vector<Correlation> correlations(const vector<Parameters>& layers);
+
+public:
+    /**
+     * @param h
+     * @throw range_error if a light cone of h has more than LIGHTCONE_MAX_INNER inner variables
+     */
+    explicit LightConeEngine(const Hamiltonian* h);
+
+    /** Check that every light cone of the Hamiltonian has at most LIGHTCONE_MAX_INNER inner variables
+     *
+     */
+    static bool fits(const Hamiltonian* h);
+
+    /** Map the terms of the Hamiltonian to their cones again, must be called after the Hamiltonian was modified
+     *
+     * @throw range_error if a light cone has more than LIGHTCONE_MAX_INNER inner variables
+     */
+    void update();
+
+    /** Compute the mean energy of the QAOA_2 state with the given layers
+     *
+     */
+    double qaoa_mean(const vector<Parameters>& layers);
+
+    /** Find the variable or the pair of variables with the largest absolute correlation in the QAOA_2 state with the given layers
+     *
+     * The candidates are the terms of the Hamiltonian and, like for QAOA_1, the pairs at distance 2 without interaction: in MWIS
+     * two nodes with a common neighbor tend to be equal. Their cone is the union of the closed neighborhoods of the two nodes,
+     * the pairs whose cone has more than LIGHTCONE_MAX_INNER inner variables are not candidates.
+     *
+     * @param layers
+     * @return the constraint fixing the sign of the most correlated term, ties are broken by the smallest (u, v)
+     */
+    Constraint find_max_correlation(const vector<Parameters>& layers);
+
+    /** Find up to k strongly correlated terms whose constraints can be added together
+     *
+     * The first one is find_max_correlation(layers), the others are the terms in decreasing order of correlation whose inner
+     * variables N[u] + N[v] don't intersect the inner variables of the already selected ones. The mean value of a term only depends
+     * on the rows of its inner variables and a constraint only changes the rows of N[u] + v, so adding one of them doesn't change
+     * the terms the others depend on. Terms with a correlation of 0 are not selected, except the first one.
+     *
+     * The candidates are those of find_max_correlation. Farther pairs are not considered, at distance more than 4 their cones are
+     * disjoint and the correlation factorizes, |<Z_uZ_w>| = |<Z_u>||<Z_w>| is not larger than the best single variable.
+     *
+     * @param layers
+     * @param k
+     * @return the constraints, in decreasing order of correlation
+     */
+    vector<Constraint> find_max_correlations(const vector<Parameters>& layers, int k);
+};
+
+#endif //QUANTUM_BNP_LIGHTCONE_H
@@ -0,0 +1,259 @@
+//
+// Created on 17/10/26.
+//
+
+#include "StateVector.h"
+#include "CorrelationCache.h"
+#include <climits>
+
+StateVector::StateVector(const Hamiltonian* h): h(h), qubits(h->actual_node_number), node_id(h->active_nodes.begin(), h->active_nodes.end()) {
+    if(qubits > STATEVECTOR_MAX_LIMIT)
+        throw range_error("Too many variables for the state vector simulation: " + to_string(qubits) + " > " + to_string(STATEVECTOR_MAX_LIMIT));
+
+    //Interactions of the active variables by qubit
+    vector<int> qubit(h->allocated, -1);
+    for(int i = 0; i < qubits; i++)
+        qubit[node_id[i]] = i;
+    vector<int> offsets(qubits + 1, 0);
+    vector<int> neighbors;
+    vector<CTYPE> coefficients;
+    long long bound = 0;
+    for(int i = 0; i < qubits; i++) {
+        const auto& row = h->interactions[node_id[i]];
+        bound += abs(h->linear[node_id[i]]);
+        for(int k = 0; k < (int) row.nodes.size(); k++) {
+            neighbors.push_back(qubit[row.nodes[k]]);
+            coefficients.push_back(row.coefficients[k]);
+            if(row.nodes[k] > node_id[i])
+                bound += abs(row.coefficients[k]);
+        }
+        offsets[i + 1] = neighbors.size();
+    }
+    if(bound > INT_MAX)
+        throw range_error("The energies of the Hamiltonian don't fit in CTYPE");
+    energy_bound = bound;
+
+    //The energies are computed in Gray code order, flipping the qubit i changes the energy by -2 s_i field_i
+    //with field_i = h_i + sum_j J_ij s_j, the ranks are split in chunks computed in parallel
+    int64_t size = (int64_t) 1 << qubits;
+    energy.resize(size);
+    int64_t chunks = min<int64_t>(size, SV_CHUNKS);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(settings().threads) if(qubits > SV_PARALLEL_QUBITS)
+    for(int64_t c = 0; c < chunks; c++) {
+        int64_t first = size * c / chunks, last = size * (c + 1) / chunks;
+        int64_t gray = first ^ (first >> 1);
+        vector<int> spin(qubits);
+        vector<long long> field(qubits);
+        for(int i = 0; i < qubits; i++) {
+            spin[i] = ((gray >> i) & 1) ? 1 : -1;
+            field[i] = h->linear[node_id[i]];
+        }
+        long long value = 0;
+        for(int i = 0; i < qubits; i++)
+            for(int k = offsets[i]; k < offsets[i + 1]; k++)
+                field[i] += (long long) coefficients[k] * spin[neighbors[k]];
+        for(int i = 0; i < qubits; i++)
+            value += (h->linear[node_id[i]] + field[i]) * spin[i];
+        value /= 2;
+
+        for(int64_t rank = first; ; ) {
+            energy[gray] = value;
+            if(++rank == last)
+                break;
+            int i = __builtin_ctzll(rank);
+            value -= 2 * spin[i] * field[i];
+            spin[i] = -spin[i];
+            gray ^= (int64_t) 1 << i;
+            for(int k = offsets[i]; k < offsets[i + 1]; k++)
+                field[neighbors[k]] += 2LL * coefficients[k] * spin[i];
+        }
+    }
+    re.resize(size);
+    im.resize(size);
+}
+
+void StateVector::apply_phase(double gamma) {
+    TrigTable trig(gamma / 2, energy_bound);
+    int64_t size = re.size();
+    double* r = re.data();
+    double* m = im.data();
+    const CTYPE* e = energy.data();
+#pragma omp parallel for simd schedule(static) num_threads(settings().threads) if(qubits > SV_PARALLEL_QUBITS)
+    for(int64_t x = 0; x < size; x++) {
+        double c = trig.cos(e[x]), s = trig.sin(e[x]);
+        double a = r[x], b = m[x];
+        r[x] = a * c + b * s;
+        m[x] = b * c - a * s;
+    }
+}
+
+void StateVector::apply_mixer(double beta) {
+    if(qubits == 0)
+        return;
+    double c = cos(beta / 2), s = sin(beta / 2);
+    int64_t size = re.size();
+    int64_t half = size / 2;
+    double* r = re.data();
+    double* m = im.data();
+
+    //The low qubits are applied block by block while the block is in the cache
+    int cache_bits = min(qubits, SV_CACHE_BITS);
+    int64_t block = (int64_t) 1 << cache_bits;
+#pragma omp parallel for schedule(static) num_threads(settings().threads) if(qubits > SV_PARALLEL_QUBITS)
+    for(int64_t b = 0; b < size; b += block)
+        for(int q = 0; q < cache_bits; q++) {
+            int64_t stride = (int64_t) 1 << q;
+            for(int64_t a = b; a < b + block; a += 2 * stride)
+                butterfly(r + a, m + a, stride, stride, c, s);
+        }
+
+    //The pairs of the high qubits are split in chunks of consecutive pairs, made of runs of contiguous amplitudes
+    int64_t chunk = half / min<int64_t>(half, SV_CHUNKS);
+    for(int q = cache_bits; q < qubits; q++) {
+        int64_t stride = (int64_t) 1 << q;
+        int64_t run = min(stride, chunk);
+#pragma omp parallel for schedule(static) num_threads(settings().threads) if(qubits > SV_PARALLEL_QUBITS)
+        for(int64_t t = 0; t < half; t += chunk)
+            for(int64_t k = t; k < t + chunk; k += run) {
+                int64_t a = ((k >> q) << (q + 1)) | (k & (stride - 1));
+                butterfly(r + a, m + a, stride, run, c, s);
+            }
+    }
+}
+
+void StateVector::prepare(const vector<Parameters> &layers) {
+    fill(re.begin(), re.end(), 1 / sqrt((double) re.size()));
+    fill(im.begin(), im.end(), 0);
+    for(const auto& p: layers) {
+        apply_phase(p.gamma);
+        apply_mixer(p.beta);
+    }
+}
+
+double StateVector::energy_mean() const {
+    int64_t size = re.size();
+    int64_t chunks = min<int64_t>(size, SV_CHUNKS);
+    vector<double> partial(chunks, 0);
+#pragma omp parallel for schedule(static) num_threads(settings().threads) if(qubits > SV_PARALLEL_QUBITS)
+    for(int64_t c = 0; c < chunks; c++) {
+        double sum = 0;
+#pragma omp simd reduction(+:sum)
+        for(int64_t x = size * c / chunks; x < size * (c + 1) / chunks; x++)
+            sum += (re[x] * re[x] + im[x] * im[x]) * energy[x];
+        partial[c] = sum;
+    }
+    double mean = 0;
+    for(const auto& sum: partial)
+        mean += sum;
+    return mean;
+}
+
+void StateVector::correlations(vector<double> &z, vector<double> &zz) const {
+    //The index of an amplitude is split into a prefix of high_bits and a block of low_bits. For each prefix the pass accumulates
+    //the probabilities of the block (for the low-low terms), their total (high-high terms) and their signed sums (high-low terms)
+    int low_bits = min(qubits, SV_BLOCK_BITS);
+    int high_bits = qubits - low_bits;
+    int64_t block = (int64_t) 1 << low_bits;
+    int64_t prefixes = (int64_t) 1 << high_bits;
+    vector<double> sign(low_bits * block);
+    for(int j = 0; j < low_bits; j++)
+        for(int64_t l = 0; l < block; l++)
+            sign[j * block + l] = ((l >> j) & 1) ? 1 : -1;
+
+    //Partial sums of each chunk of prefixes, added in a fixed order so that the result doesn't depend on the number of threads
+    using Accumulator = struct Accumulator {
+        vector<double> histogram; // probability of each assignment of the low qubits
+        vector<double> high_z;
+        vector<double> high_zz; // high_zz[i * high_bits + k] for i < k
+        vector<double> cross; // cross[i * low_bits + j], high qubit i and low qubit j
+    };
+    int64_t chunks = min<int64_t>(prefixes, SV_CHUNKS);
+    vector<Accumulator> partial(chunks);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(settings().threads) if(qubits > SV_PARALLEL_QUBITS)
+    for(int64_t c = 0; c < chunks; c++) {
+        Accumulator& acc = partial[c];
+        acc.histogram.assign(block, 0);
+        acc.high_z.assign(high_bits, 0);
+        acc.high_zz.assign(high_bits * high_bits, 0);
+        acc.cross.assign(high_bits * low_bits, 0);
+        vector<double> probability(block);
+        vector<double> low_z(low_bits);
+        for(int64_t prefix = prefixes * c / chunks; prefix < prefixes * (c + 1) / chunks; prefix++) {
+            const double* r = re.data() + (prefix << low_bits);
+            const double* m = im.data() + (prefix << low_bits);
+            double* pr = probability.data();
+            double* histogram = acc.histogram.data();
+            double total = 0;
+#pragma omp simd reduction(+:total)
+            for(int64_t l = 0; l < block; l++) {
+                pr[l] = r[l] * r[l] + m[l] * m[l];
+                histogram[l] += pr[l];
+                total += pr[l];
+            }
+            for(int j = 0; j < low_bits; j++) {
+                const double* sj = sign.data() + j * block;
+                double sum = 0;
+#pragma omp simd reduction(+:sum)
+                for(int64_t l = 0; l < block; l++)
+                    sum += pr[l] * sj[l];
+                low_z[j] = sum;
+            }
+            for(int i = 0; i < high_bits; i++) {
+                double si = ((prefix >> i) & 1) ? 1 : -1;
+                acc.high_z[i] += si * total;
+                for(int k = i + 1; k < high_bits; k++)
+                    acc.high_zz[i * high_bits + k] += (((prefix >> k) & 1) ? si : -si) * total;
+                for(int j = 0; j < low_bits; j++)
+                    acc.cross[i * low_bits + j] += si * low_z[j];
+            }
+        }
+    }
+
+    z.assign(qubits, 0);
+    zz.assign(qubits * qubits, 0);
+    vector<double> histogram(block, 0);
+    for(const auto& acc: partial) {
+        for(int64_t l = 0; l < block; l++)
+            histogram[l] += acc.histogram[l];
+        for(int i = 0; i < high_bits; i++) {
+            z[low_bits + i] += acc.high_z[i];
+            for(int k = i + 1; k < high_bits; k++)
+                zz[(low_bits + i) * qubits + low_bits + k] += acc.high_zz[i * high_bits + k];
+            for(int j = 0; j < low_bits; j++)
+                zz[j * qubits + low_bits + i] += acc.cross[i * low_bits + j];
+        }
+    }
+    for(int j = 0; j < low_bits; j++)
+        for(int64_t l = 0; l < block; l++) {
+            z[j] += histogram[l] * sign[j * block + l];
+            for(int k = j + 1; k < low_bits; k++)
+                zz[j * qubits + k] += histogram[l] * sign[j * block + l] * sign[k * block + l];
+        }
+    for(int i = 0; i < qubits; i++)
+        for(int k = i + 1; k < qubits; k++)
+            zz[k * qubits + i] = zz[i * qubits + k];
+}
+
+double StateVector::qaoa_mean(const vector<Parameters> &layers) {
+    prepare(layers);
+    return energy_mean();
+}
+
+Constraint StateVector::find_max_correlation(const vector<Parameters> &layers) {
+    prepare(layers);
+    vector<double> z, zz;
+    correlations(z, zz);
+
+    Correlation output = {0, {1, *h->active_nodes.begin(), -1}};
+    for(int i = 0; i < qubits; i++) {
+        auto candidate = make_correlation(z[i], node_id[i], -1);
+        if(candidate.better_than(output))
+            output = candidate;
+        for(int k = i + 1; k < qubits; k++) {
+            candidate = make_correlation(zz[i * qubits + k], min(node_id[i], node_id[k]), max(node_id[i], node_id[k]));
+            if(candidate.better_than(output))
+                output = candidate;
+        }
+    }
+    return output.constraint;
+}
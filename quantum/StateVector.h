@@ -0,0 +1,104 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_STATEVECTOR_H
+#define QUANTUM_BNP_STATEVECTOR_H
+
+#include "Hamiltonian.h"
+
+//The correlations are accumulated by blocks of 2^SV_BLOCK_BITS amplitudes that differ in the low qubits
+#define SV_BLOCK_BITS 8
+
+//The mixers of the qubits below SV_CACHE_BITS are applied to one block of 2^SV_CACHE_BITS amplitudes at a time
+#define SV_CACHE_BITS 12
+
+//Number of chunks of the amplitudes processed in parallel, the partial sums are added in a fixed order
+#define SV_CHUNKS 64
+
+//Elementwise passes over fewer amplitudes than 2^SV_PARALLEL_QUBITS run on one thread
+#define SV_PARALLEL_QUBITS 14
+
+/** Apply exp(-i beta/2 X) to the pairs of amplitudes (a[j], a[j + stride]) for 0 <= j < count, c = cos(beta/2), s = sin(beta/2)
+ *
+ */
+inline void butterfly(double* re, double* im, int64_t stride, int64_t count, double c, double s) {
+    double* re_b = re + stride;
+    double* im_b = im + stride;
+#pragma omp simd
+    for(int64_t j = 0; j < count; j++) {
+        double x = re[j], y = im[j], u = re_b[j], v = im_b[j];
+        re[j] = c * x + s * v;
+        im[j] = c * y - s * u;
+        re_b[j] = c * u + s * y;
+        im_b[j] = c * v - s * x;
+    }
+}
+
+/** Exact simulation of the QAOA_p state of the active variables of a Hamiltonian
+ *
+ * The state is exp(-i beta_p/2 B) exp(-i gamma_p/2 C) ... exp(-i beta_1/2 B) exp(-i gamma_1/2 C) |+>^n with B = sum X_u,
+ * so for p = 1 the mean values are those of Hamiltonian::z_mean and Hamiltonian::zz_mean. Qubit i is the variable node_id[i],
+ * bit i of the index of an amplitude is set if Z_{node_id[i]} = +1.
+ *
+ * The diagonal of the Hamiltonian is computed once in the constructor, the amplitudes are stored as separate arrays of real
+ * and imaginary parts. The memory is 20 bytes per amplitude.
+ */
+class StateVector {
+    const Hamiltonian* h;
+    int qubits;
+    vector<N_ID> node_id;
+    vector<CTYPE> energy; // energy[x] is the value of the Hamiltonian in the basis state x
+    int energy_bound; // bound on |energy[x]|
+    vector<double> re;
+    vector<double> im;
+
+    /** Multiply the amplitude of each basis state x by exp(-i gamma/2 energy[x])
+     *
+     */
+    void apply_phase(double gamma);
+
+    /** Apply exp(-i beta/2 X) to every qubit, a butterfly over the pairs of amplitudes that differ in the qubit
+     *
+     */
+    void apply_mixer(double beta);
+
+public:
+    /** Compute the diagonal of the Hamiltonian restricted to its active variables
+     *
+     * @param h
+     * @throw range_error if there are more than STATEVECTOR_MAX_LIMIT active variables or the energies don't fit in CTYPE
+     */
+    explicit StateVector(const Hamiltonian* h);
+
+    /** Prepare the QAOA state with one layer per element of layers
+     *
+     */
+    void prepare(const vector<Parameters>& layers);
+
+    /** Compute the mean energy of the prepared state
+     *
+     */
+    double energy_mean() const;
+
+    /** Compute the mean values of Z_i and Z_iZ_j of the prepared state in one pass over the amplitudes
+     *
+     * @param z z[i] = <Z_i> for the qubit i
+     * @param zz zz[i * qubits + j] = <Z_iZ_j> for the qubits i != j
+     */
+    void correlations(vector<double>& z, vector<double>& zz) const;
+
+    /** Compute the mean energy of the QAOA state with the given layers
+     *
+     */
+    double qaoa_mean(const vector<Parameters>& layers);
+
+    /** Find the variable or the pair of variables with the largest absolute correlation in the QAOA state with the given layers
+     *
+     * @param layers
+     * @return the constraint fixing the sign of the most correlated term, ties are broken by the smallest (u, v)
+     */
+    Constraint find_max_correlation(const vector<Parameters>& layers);
+};
+
+#endif //QUANTUM_BNP_STATEVECTOR_H
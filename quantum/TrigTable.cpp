@@ -0,0 +1,60 @@
+//
+// Created on 17/10/26.
+//
+
+#include "TrigTable.h"
+
+TrigTable::TrigTable(double gamma, int max_k): gamma(gamma), direct(max_k > TRIG_TABLE_MAX_COEFFICIENT),
+        center(max_k) {
+    if(direct)
+        return;
+    cosines.resize(2 * max_k + 1);
+    sines.resize(2 * max_k + 1);
+    double c1 = std::cos(gamma), s1 = std::sin(gamma);
+    double* c = cosines.data() + max_k;
+    double* s = sines.data() + max_k;
+    for(int k = 0; k <= max_k; k++) {
+        if(k % TRIG_TABLE_BLOCK == 0) {
+            c[k] = std::cos(gamma * k);
+            s[k] = std::sin(gamma * k);
+        }
+        else {
+            c[k] = c[k - 1] * c1 - s[k - 1] * s1;
+            s[k] = s[k - 1] * c1 + c[k - 1] * s1;
+        }
+        c[-k] = c[k];
+        s[-k] = -s[k];
+    }
+}
+
+//Gathers from the table are vectorized with AVX2 when the processor supports it
+__attribute__((target_clones("avx2", "default")))
+static double table_product(const double* table, const int* coefficients, int size) {
+    double product = 1;
+#pragma omp simd reduction(*:product)
+    for(int i = 0; i < size; i++)
+        product *= table[coefficients[i]];
+    return product;
+}
+
+double TrigTable::cos_product(const int* coefficients, int size) const {
+    if(!direct)
+        return table_product(cosines.data() + center, coefficients, size);
+    double product = 1;
+    for(int i = 0; i < size; i++)
+        product *= std::cos(gamma * coefficients[i]);
+    return product;
+}
+
+double TrigTable::cos_product(const int* coefficients, int size, double& derivative) const {
+    //(product, derivative) is multiplied by (cos(gamma k), -k sin(gamma k)) with the product rule
+    double product = 1;
+    derivative = 0;
+    for(int i = 0; i < size; i++) {
+        int k = coefficients[i];
+        double c = cos(k);
+        derivative = derivative * c - k * sin(k) * product;
+        product *= c;
+    }
+    return product;
+}
@@ -0,0 +1,48 @@
+//
+// Created on 17/10/26.
+//
+
+#ifndef QUANTUM_BNP_TRIGTABLE_H
+#define QUANTUM_BNP_TRIGTABLE_H
+
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+//Tables are built only for coefficients of absolute value at most TRIG_TABLE_MAX_COEFFICIENT, otherwise the values are computed directly
+#define TRIG_TABLE_MAX_COEFFICIENT (1 << 16)
+
+//The recurrence restarts from exact values every TRIG_TABLE_BLOCK entries to bound the accumulated rounding error
+#define TRIG_TABLE_BLOCK 64
+
+/** Values of cos(gamma * k) and sin(gamma * k) for the integers -max_k <= k <= max_k
+ *
+ * The Ising coefficients are integers, so for a fixed gamma all angles in the QAOA mean values are multiples of gamma.
+ * The table is filled with the angle-addition recurrence cos((k+1)g) = cos(kg)cos(g) - sin(kg)sin(g), sin((k+1)g) = sin(kg)cos(g) + cos(kg)sin(g).
+ */
+class TrigTable {
+    double gamma;
+    bool direct; // true if the table is too large and the values are computed on demand
+    vector<double> cosines; // cosines[center + k] = cos(gamma * k)
+    vector<double> sines;
+    int center; // an index rather than a pointer into the vectors, so that copies of the table stay valid
+
+public:
+    TrigTable(double gamma, int max_k);
+
+    double cos(int k) const { return direct ? std::cos(gamma * k) : cosines[center + k]; };
+    double sin(int k) const { return direct ? std::sin(gamma * k) : sines[center + k]; };
+
+    /** Compute the product of cos(gamma * coefficients[i]) for 0 <= i < size
+     *
+     */
+    double cos_product(const int* coefficients, int size) const;
+
+    /** Compute the product of cos(gamma * coefficients[i]) for 0 <= i < size and its derivative with respect to gamma
+     *
+     */
+    double cos_product(const int* coefficients, int size, double& derivative) const;
+};
+
+#endif //QUANTUM_BNP_TRIGTABLE_H
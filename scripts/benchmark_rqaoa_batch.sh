@@ -0,0 +1,26 @@
+#!/bin/bash
+# Compare the weight of the sets found by -quantum and the running time with the one-at-a-time schedule and with batch eliminations
+#
+# Usage: scripts/benchmark_rqaoa_batch.sh <path to Quantum_BnP> [instance files...]
+# Environment: BATCHES (default "1 4 16"), SEEDS (default "0 1 2"), OPTIONS (additional options, e.g. "--threads=8")
+
+BINARY=${1:?"Usage: $0 <path to Quantum_BnP> [instance files...]"}
+shift
+INSTANCES=("$@")
+if [ ${#INSTANCES[@]} -eq 0 ]; then
+    INSTANCES=(test_data/graphs_400/*.mwis)
+fi
+BATCHES=${BATCHES:-"1 4 16"}
+SEEDS=${SEEDS:-"0 1 2"}
+
+printf "%-45s %6s %6s %8s %10s\n" instance batch seed weight seconds
+for instance in "${INSTANCES[@]}"; do
+    for batch in $BATCHES; do
+        for seed in $SEEDS; do
+            start=$(date +%s.%N)
+            weight=$("$BINARY" -MWIS "$instance" -quantum -noreduce --rqaoa_batch="$batch" --seed="$seed" $OPTIONS 2>&1 | sed -n 's/.*value: //p')
+            end=$(date +%s.%N)
+            printf "%-45s %6s %6s %8s %10.2f\n" "$instance" "$batch" "$seed" "${weight:-failed}" "$(awk "BEGIN {print $end - $start}")"
+        done
+    done
+done